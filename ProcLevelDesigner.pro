@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -13,6 +13,16 @@ TEMPLATE = app
 
 QMAKE_CXXFLAGS += -std=c++11
 
+# Build with CONFIG+=profile to record a trace of load, save and generation times (see include/profiler.h)
+profile {
+    DEFINES += PLD_PROFILE
+}
+
+# Build with CONFIG+=roundtrip to check every saved table reads back identically (warnings are printed on failure)
+roundtrip {
+    DEFINES += PLD_CHECK_ROUNDTRIP
+}
+
 SOURCES += \
     src/main.cpp \
     src/quest.cpp \
@@ -21,6 +31,8 @@ SOURCES += \
     src/ui/newquestdialog.cpp \
     src/ui/openquestdialog.cpp \
     src/map.cpp \
+    src/mapentity.cpp \
+    src/spatialhash.cpp \
     src/tileset.cpp \
     src/ui/newtilesetdialog.cpp \
     src/ui/questdatabase.cpp \
@@ -33,7 +45,21 @@ SOURCES += \
     src/applicationdispatcher.cpp \
     src/ui/solarusdirectorydialog.cpp \
     src/preferences.cpp \
-    src/ui/mission/editgatedialog.cpp
+    src/ui/mission/editgatedialog.cpp \
+    src/pathfinder.cpp \
+    src/mapview.cpp \
+    src/mapstroke.cpp \
+    src/undostack.cpp \
+    src/editcommands.cpp \
+    src/questwatcher.cpp \
+    src/questloader.cpp \
+    src/questvalidator.cpp \
+    src/worldgenerator.cpp \
+    src/imagepyramid.cpp \
+    src/thumbnailcache.cpp \
+    src/atlaspacker.cpp \
+    src/profiler.cpp \
+    src/questindex.cpp
 
 HEADERS  += \
     include/common.h \
@@ -43,6 +69,8 @@ HEADERS  += \
     include/ui/newquestdialog.h \
     include/ui/openquestdialog.h \
     include/map.h \
+    include/mapentity.h \
+    include/spatialhash.h \
     include/tileset.h \
     include/ui/newtilesetdialog.h \
     include/ui/questdatabase.h \
@@ -55,7 +83,21 @@ HEADERS  += \
     include/applicationdispatcher.h \
     include/ui/solarusdirectorydialog.h \
     include/preferences.h \
-    include/ui/mission/editgatedialog.h
+    include/ui/mission/editgatedialog.h \
+    include/pathfinder.h \
+    include/mapview.h \
+    include/mapstroke.h \
+    include/undostack.h \
+    include/editcommands.h \
+    include/questwatcher.h \
+    include/questloader.h \
+    include/questvalidator.h \
+    include/worldgenerator.h \
+    include/imagepyramid.h \
+    include/thumbnailcache.h \
+    include/atlaspacker.h \
+    include/profiler.h \
+    include/questindex.h
 
 FORMS    += \
     ui/editorwindow.ui \
@@ -0,0 +1,61 @@
+#ifndef ATLASPACKER_H
+#define ATLASPACKER_H
+
+#include <QList>
+#include <QPoint>
+#include <QSize>
+#include <QVector>
+
+const int ATLAS_ALIGNMENT = 8; /*!< Solarus requires pattern positions and sizes to be multiples of 8 pixels. */
+
+/*!
+ * \brief Packs rectangles into an area of fixed width and unbounded height, using the skyline bottom-left heuristic.
+ *        The top edge of everything placed so far is kept as a list of horizontal segments, and each rectangle is
+ *        placed on the segment where its top ends up lowest.
+ *
+ * Rectangles pack best when inserted tallest first.
+ */
+class AtlasPacker
+{
+public:
+    AtlasPacker(int width);
+
+    /*!
+     * \brief Finds a place for a rectangle, and marks the area as used.
+     * \param position Receives the top left corner of the rectangle.
+     * \return False if the rectangle is wider than the packing area.
+     */
+    bool insert(QSize size, QPoint* position);
+
+    inline int getWidth() const { return width; }
+
+    /*!
+     * \brief Retrieves the height of the area used so far.
+     */
+    int getHeight() const;
+
+    /*!
+     * \brief Suggests a width for packing the given rectangles into a roughly square area.
+     */
+    static int suggestWidth(const QList<QSize>& sizes);
+
+private:
+    struct SkylineNode
+    {
+        SkylineNode() : x(0), y(0), width(0) { }
+        SkylineNode(int x, int y, int width) : x(x), y(y), width(width) { }
+
+        int x, y, width;
+    };
+
+    /*!
+     * \brief Checks whether a rectangle of the given width fits when its left edge is at the start of a node.
+     * \param y Receives the height the rectangle would rest at.
+     */
+    bool fits(int index, int rectWidth, int* y) const;
+
+    int width;
+    QVector<SkylineNode> skyline; /*!< Segments of the top edge, from left to right, covering the whole width. */
+};
+
+#endif // ATLASPACKER_H
@@ -0,0 +1,130 @@
+#ifndef EDITCOMMANDS_H
+#define EDITCOMMANDS_H
+
+#include <QVector>
+
+#include "undostack.h"
+#include "map.h"
+#include "tileset.h"
+#include "missionitemcollection.h"
+
+/*!
+ * \brief IDs used by commands that can be merged.
+ */
+enum EditCommandId
+{
+    PATTERN_TOGGLE_COMMAND = 1
+};
+
+/*!
+ * \brief A run of consecutive tiles that all changed from the same pattern to the same pattern.
+ */
+struct TileRun
+{
+    int start;      /*!< Row-major index of the first tile in the run. */
+    int count;      /*!< Number of tiles in the run. */
+    int oldPattern;
+    int newPattern;
+};
+
+/*!
+ * \brief Undoes a batch of tile changes (such as a finished MapStroke). Changes are stored as runs of tiles, so fills
+ *        cost a few bytes per row rather than per tile.
+ */
+class MapEditCommand : public UndoCommand
+{
+public:
+    MapEditCommand(Map* map, QVector<TileChange> changes, QString text = "Edit Map");
+
+    void undo() override;
+    void redo() override;
+    qint64 cost() const override;
+
+private:
+    void apply(bool reverse);
+
+    Map* map;
+    QVector<TileRun> runs;
+    int changeCount; /*!< Total number of tiles changed. */
+};
+
+/*!
+ * \brief Undoes changes to the traversable state of tile patterns. Toggles made during the same drag are merged.
+ */
+class PatternToggleCommand : public UndoCommand
+{
+public:
+    /*!
+     * \param tileset The tileset containing the pattern.
+     * \param patternId The ID of the pattern that was changed.
+     * \param blocked True if the pattern was made non-traversable, false if it was made traversable.
+     * \param dragId Identifies the drag the change was made in, only changes from the same drag are merged.
+     */
+    PatternToggleCommand(Tileset* tileset, int patternId, bool blocked, int dragId);
+
+    void undo() override;
+    void redo() override;
+    int id() const override { return PATTERN_TOGGLE_COMMAND; }
+    bool mergeWith(const UndoCommand* other) override;
+    qint64 cost() const override;
+
+private:
+    void apply(bool traversable);
+
+    Tileset* tileset;
+    QVector<int> patternIds;
+    bool blocked;
+    int dragId;
+};
+
+/*!
+ * \brief Undoes the addition, removal or modification of a key event.
+ */
+class KeyEventCommand : public UndoCommand
+{
+public:
+    enum Action
+    {
+        Add,    /*!< newKey was added. */
+        Remove, /*!< oldKey was removed. */
+        Edit    /*!< oldKey was replaced by newKey. */
+    };
+
+    KeyEventCommand(MissionItemCollection* items, Action action, Key oldKey, Key newKey);
+
+    void undo() override;
+    void redo() override;
+    qint64 cost() const override;
+
+private:
+    MissionItemCollection* items;
+    Action action;
+    Key oldKey, newKey;
+};
+
+/*!
+ * \brief Undoes the addition, removal or modification of a gate.
+ */
+class GateCommand : public UndoCommand
+{
+public:
+    enum Action
+    {
+        Add,    /*!< newGate was added. */
+        Remove, /*!< oldGate was removed. */
+        Edit    /*!< oldGate was replaced by newGate. */
+    };
+
+    GateCommand(MissionItemCollection* items, Action action, Gate oldGate, Gate newGate);
+
+    void undo() override;
+    void redo() override;
+    qint64 cost() const override;
+
+private:
+    MissionItemCollection* items;
+    Action action;
+    Gate oldGate, newGate;
+};
+
+#endif // EDITCOMMANDS_H
@@ -9,6 +9,10 @@
 #include <QTextStream>
 #include <QVector>
 #include <QChar>
+#include <QSet>
+#include <QHash>
+#include <QStringList>
+#include <QDateTime>
 
 // Used to represent an object or element that does not exist or was not found.
 const QString NULL_ELEMENT = "NULL_ELEMENT";
@@ -46,6 +50,27 @@ const QString ELE_MUSIC = "music";
 const QString ELE_LAYER = "layer";
 const QString ELE_PATTERN = "pattern";
 
+// Map entities
+const QString OBJ_DESTINATION = "destination";
+const QString OBJ_TELETRANSPORTER = "teletransporter";
+const QString OBJ_CHEST = "chest";
+const QString OBJ_NPC = "npc";
+const QString OBJ_DOOR = "door";
+const QString OBJ_SWITCH = "switch";
+const QString OBJ_PICKABLE = "pickable";
+const QString ELE_DIRECTION = "direction";
+const QString ELE_TRANSITION = "transition";
+const QString ELE_DESTINATION_MAP = "destination_map";
+const QString ELE_DESTINATION = "destination";
+const QString ELE_SPRITE = "sprite";
+const QString ELE_SUBTYPE = "subtype";
+const QString ELE_OPENING_METHOD = "opening_method";
+const QString ELE_SAVEGAME_VARIABLE = "savegame_variable";
+const QString ELE_TREASURE_SAVEGAME_VARIABLE = "treasure_savegame_variable";
+const QString ELE_NEEDS_BLOCK = "needs_block";
+const QString ELE_INACTIVATE_WHEN_LEAVING = "inactivate_when_leaving";
+const QString TRANSITION_FADE = "fade";
+
 // Tileset
 const QString OBJ_TILE_PATTERN = "tile_pattern";
 const QString ELE_DEFAULT_LAYER = "default_layer";
@@ -72,10 +97,11 @@ const QString OBJ_PREFERENCES = "preferences";
 const QString ELE_SOLARUS_PATH = "solarus_path";
 
 // Object, element and value delimiters for parsing and building .dat files.
-const QVector<QChar> FIND_OBJ_DELIMS =  {'{'};
-const QVector<QChar> OBJ_DELIMS =       {'}'};
-const QVector<QChar> ELEM_DELIMS =      {'='};
-const QVector<QChar> VAL_DELIMS =       {','};
+const char OBJ_BEGIN =      '{';
+const char OBJ_END =        '}';
+const char ELEM_ASSIGN =    '=';
+const char VAL_SEPARATOR =  ',';
+const char STRING_QUOTE =   '"';
 
 
 /*!
@@ -109,12 +135,22 @@ public:
     QString find(QString element, QString defaultVal = "NULL");
     void insert(QString element, QString value);
 
+    /*!
+     * \brief Sets an element, unless it already holds the given value.
+     * \return True if the object changed.
+     */
+    bool update(QString element, QString value);
+
     bool operator==(const Object& param);
     bool operator!=(const Object& param);
 };
 
+struct TableEntry;
+
 /*!
- * \brief Class representing a table of data from a .dat file.
+ * \brief Class representing a table of data from a .dat file. Objects are kept in the order they appear in the file, and
+ *        objects that have not changed are written back exactly as they were read, so saving only rewrites the text of
+ *        objects that were added or modified.
  */
 class Table
 {
@@ -143,7 +179,9 @@ public:
     QString getFilePath() const;
 
     /*!
-     * \brief saveToDisk Writes out data in the table to the currently specified file path.
+     * \brief saveToDisk Writes out data in the table to the currently specified file path. Unchanged objects are copied
+     *        from the text they were read from in large blocks, only changed objects are rebuilt. Does nothing if the
+     *        table is unmodified and its file is unchanged on disk.
      */
     void saveToDisk();
 
@@ -153,12 +191,62 @@ public:
      */
     void parse(QString filePath);
 
+    /*!
+     * \brief Parses the contents of a .dat file held in memory into the table, replacing its current contents. The
+     *        table's file path is not used.
+     */
+    void parseData(const QByteArray& bytes);
+
+    /*!
+     * \brief Serializes the table into the contents of a .dat file, exactly as saveToDisk would write it.
+     */
+    QByteArray toData();
+
     /*!
      * \brief Adds an object to the table.
      * \param name The name of the object.
      * \param object The object to add to the table.
+     * \return Pointer to the object stored in the table, added after all existing objects. Remains valid until the object
+     *         is removed or the table cleared.
+     */
+    Object* addObject(QString name, Object object);
+
+    /*!
+     * \brief Removes a single object from the table, in constant time.
+     * \param name The name of the object.
+     * \param object Pointer to the object, as returned by addObject or one of the getters.
+     * \return True if the object was found and removed.
+     */
+    bool removeObject(QString name, Object* object);
+
+    /*!
+     * \brief Marks an object that was modified through its pointer as changed.
+     */
+    void markDirty(Object* object);
+
+    /*!
+     * \brief Returns whether or not the table has been modified since it was last parsed or saved.
+     */
+    inline bool isModified() const { return modified; }
+
+    /*!
+     * \brief Returns a number that changes whenever the contents of the table change, including through markDirty.
+     *        Revisions are unique across every table in the process, so caches built from any table can tell whether
+     *        they are out of date from the revision alone.
      */
-    void addObject(QString name, Object object);
+    inline quint64 getRevision() const { return revision; }
+
+    /*!
+     * \brief Checks whether the file on disk was changed by something other than this table since the table last parsed
+     *        or saved it. Only compares the file's size and modification time, the file is not read.
+     */
+    bool changedOnDisk() const;
+
+    /*!
+     * \brief Replaces the contents of this table with the contents of another table, leaving the other table empty.
+     *        Pointers to objects in this table are invalidated. Used to swap in a table parsed on another thread.
+     */
+    void replaceContents(Table* source);
 
     /*!
      * \brief Retrieve an object's collection of elements and their values. If multiple objects of the same name are found, returns
@@ -178,12 +266,18 @@ public:
     QString getElementValue(QString objectName, QString elementName);
 
     /*!
-     * \brief getObjects Retrieves a QList of all objects.
+     * \brief getObjects Retrieves a QList of all objects, in the order they appear in the file.
      */
     QList<Object*> getObjects();
 
     /*!
-     * \brief Retrieves a QList of all objects with the given name.
+     * \brief Retrieves the name of an object in the table.
+     * \return The object's name, or an empty string if the object is not part of the table.
+     */
+    QString getObjectName(Object* object) const;
+
+    /*!
+     * \brief Retrieves a QList of all objects with the given name, in the order they appear in the file.
      * \param objectName The name of the objects to retrieve.
      * \return List of all objects with the given name.
      */
@@ -219,7 +313,8 @@ public:
     void clear();
 
     /*!
-     * \brief areEqual Compares this table to the given table. Returns false if they have any differences.
+     * \brief areEqual Compares this table to the given table, including object names. Returns false if they have any
+     *        differences.
      */
     bool areEqual(Table* table);
 
@@ -234,32 +329,33 @@ public:
 
 private:
 
-    // Reading Functions
-    void beginRead();
-    void findObj();
-    void readObj();
-    void readElements();
-
     // Writing Functions
-    void beginWrite();
-    void writeObj(QString objectName, Object object);
-
     /*!
-     * \brief readUntil Read a given text stream until the delimiter value is found.
-     * \param delim The delimiter value.
-     * \return Value read until the given delimiter value.
+     * \brief Writes out every object, copying unchanged objects from the source text.
+     * \param rebase If true, objects are re-based onto the written text, which becomes the table's new source.
      */
-    QString readUntil(QTextStream& stream, QVector<QChar> delims);
+    void beginWrite(QByteArray& bytes, bool rebase);
 
-    QString currentObjectName, currentElement, currentObject; /*!< The current object and element in the parser state. */
+    void appendEntry(TableEntry* entry);
+    TableEntry* findEntry(Object* object) const; /*!< Returns null if the object is not a live object of this table. */
+    void compact();                              /*!< Frees the entries of removed objects. */
 
-    Object curObjectData; /*!< Data stored by the current object. */
-    QFile file;           /*!< The file currently being used for reading. */
-    QTextStream in;       /*!< The stream currently being used for reading. */
-    QTextStream out;      /*!< The stream currently being used for writing. */
+    QFile file;           /*!< The file last read from or written to. */
 
     QString filePath;
-    QMultiMap<QString, Object> objects; /*!< Map of all objects, containing a map of respective elements. */
+    QVector<TableEntry*> entries;          /*!< All objects in file order, including removed objects not compacted yet. */
+    QHash<QString,TableEntry*> lastOfName; /*!< The most recently added object of each name. */
+    int removedCount;                      /*!< Number of removed objects still in the list of entries. */
+
+    QByteArray sourceData; /*!< Text the table was last parsed from or saved as, unchanged objects are copied from it. */
+    int trailerBegin;      /*!< Start of the text following the last object in the source. */
+
+    bool modified;                /*!< Whether or not the table differs from the file it was last parsed from or saved to. */
+    quint64 revision;             /*!< Replaced with a new process-wide revision on every change to the table's contents. */
+
+    void updateSyncState();       /*!< Records the size and modification time of the file, after a parse or save. */
+    QDateTime syncTime;           /*!< Modification time of the file when it was last parsed or saved. */
+    qint64 syncSize;              /*!< Size of the file when it was last parsed or saved. */
 };
 
 
@@ -0,0 +1,43 @@
+#ifndef IMAGEPYRAMID_H
+#define IMAGEPYRAMID_H
+
+#include <QImage>
+#include <QVector>
+
+const int THUMBNAIL_SIZE = 64; /*!< Maximum width and height of a thumbnail, in pixels. */
+
+/*!
+ * \brief A chain of progressively halved copies of an image, down to thumbnail size. Each level is filtered from the one
+ *        above it, which looks better than scaling the full image down in one step. Images are not tied to the GUI
+ *        thread, so pyramids can be built on worker threads.
+ */
+class ImagePyramid
+{
+public:
+    ImagePyramid() { }
+
+    /*!
+     * \brief Builds a pyramid from the given image.
+     * \param minSize Halving stops once the width and height both fit within this size.
+     */
+    static ImagePyramid build(const QImage& image, int minSize = THUMBNAIL_SIZE);
+
+    inline int getLevelCount() const      { return levels.size(); }
+    inline QImage getLevel(int level) const { return levels[level]; }
+
+    /*!
+     * \brief Finds the smallest level that is still at least the given scale of the full image.
+     * \return The index of the level, or 0 if the pyramid is empty.
+     */
+    int getLevelForScale(qreal scale) const;
+
+    /*!
+     * \brief Retrieves the smallest level, or a null image if the pyramid is empty.
+     */
+    QImage getThumbnail() const;
+
+private:
+    QVector<QImage> levels; /*!< Level 0 is the full image, every following level is half the size of the one before. */
+};
+
+#endif // IMAGEPYRAMID_H
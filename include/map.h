@@ -3,10 +3,14 @@
 
 #include <QString>
 #include <QVector>
+#include <QList>
+#include <QRect>
 #include <QDebug>
 
 #include "filetools.h"
 #include "tileset.h"
+#include "mapentity.h"
+#include "spatialhash.h"
 
 const int DEFAULT_TILE_SIZE = 32;
 const int DEFAULT_MAP_SIZE = DEFAULT_TILE_SIZE * 10;
@@ -21,29 +25,70 @@ const QString DEFAULT_MAP_WORLD = "outside";
 struct MapTile
 {
 public:
-    MapTile() { }
+    MapTile() : layer(0), x(0), y(0), width(DEFAULT_TILE_SIZE), height(DEFAULT_TILE_SIZE), pattern(0) { }
     MapTile(int layer, int X, int Y, int size, int pattern) :
-        layer(layer), x(X), y(Y), size(size), pattern(pattern) { }
+        layer(layer), x(X), y(Y), width(size), height(size), pattern(pattern) { }
 
     static MapTile parse(Object* object); /*!< Parses a map tile from a given data object. */
-    static Object build(MapTile tile); /*!< Builds an object from a map tile. */
+
+    /*!
+     * \brief Builds an object from a map tile.
+     * \param tileSize Size of the map's grid, tiles are positioned in grid cells but written in pixels.
+     */
+    static Object build(MapTile tile, int tileSize);
 
     // Getters
     inline int getLayer() const        { return layer; }
     inline int getX() const            { return x; }
     inline int getY() const            { return y; }
-    inline int getSize() const         { return size; }
+    inline int getWidth() const        { return width; }
+    inline int getHeight() const       { return height; }
     inline int getPattern() const      { return pattern; }
 
     // Setters
     inline void setLayer(int layer)     { this->layer = layer; }
     inline void setX(int x)             { this->x = x; }
     inline void setY(int y)             { this->y = y; }
-    inline void setSize(int size)       { this->size = size; }
+    inline void setWidth(int width)     { this->width = width; }
+    inline void setHeight(int height)   { this->height = height; }
     inline void setPattern(int pattern) { this->pattern = pattern; }
 
 private:
-    int layer, x, y, size, pattern;
+    int layer, x, y;
+    int width, height; /*!< Area covered by the tile in pixels, its pattern is repeated over it. */
+    int pattern;
+};
+
+/*!
+ * \brief A change to the pattern of a single tile.
+ */
+struct TileChange
+{
+    TileChange() : index(0), oldPattern(0), newPattern(0) { }
+    TileChange(int index, int oldPattern, int newPattern) :
+        index(index), oldPattern(oldPattern), newPattern(newPattern) { }
+
+    int index;      /*!< Row-major index of the tile within the map (y * width + x). */
+    int oldPattern; /*!< Pattern before the change. */
+    int newPattern; /*!< Pattern after the change. */
+};
+
+class Map;
+
+/*!
+ * \brief Interface for objects (such as views) that need to know when tiles in a map change.
+ */
+class MapObserver
+{
+public:
+    virtual ~MapObserver() { }
+
+    /*!
+     * \brief Called once per batch of changes.
+     * \param map The map that changed.
+     * \param area The area (in tiles) containing every changed tile.
+     */
+    virtual void tilesChanged(Map* map, const QRect& area) = 0;
 };
 
 /*!
@@ -59,10 +104,11 @@ public:
     /*!
      * \brief Parses a map from the table into this object.
      * \param data The table containing the map data.
-     * \param tileSet The data for the tileset to be used by this map.
+     * \param tileSize Size of the grid tiles are placed on, taken from the map's tileset. Sizes and positions in the
+     *        table are in pixels, so a map parsed before its tileset is known has to be parsed again once it is.
      * \return Copy of the map that was created.
      */
-    static Map parse(QString name, Table* data);
+    static Map parse(QString name, Table* data, int tileSize = DEFAULT_TILE_SIZE);
 
     /*!
      * \brief Build the map, creating a table containing all of it's contents.
@@ -79,12 +125,86 @@ public:
     inline int getTileSize() const      { return tileSize; }
 
     inline void setName(const QString& name)          { this->name = name; }
-    inline void setTileSet(Tileset* tileSet)    { this->tileSet = tileSet; }
+    void setTileSet(Tileset* tileSet);
     inline void setMusic(const QString& music)        { this->music = music; }
-    inline void setTileSize(const int& size)          { this->tileSize = size; }
+    void setTileSize(const int& size);
 
     void setTile(int x, int y, const MapTile& tile);
-    const MapTile& getTile(int x, int y);
+    const MapTile& getTile(int x, int y) const;
+
+    /*!
+     * \brief Retrieves the area a tile is drawn over, in pixels. Tiles cover the size of their pattern, which may span
+     *        several grid cells, or a single cell if the pattern is not found.
+     */
+    QRect getTileBounds(int x, int y) const;
+
+    /*!
+     * \brief Finds the tiles drawn over an area, including tiles outside the area whose pattern spills into it. Tiles in
+     *        the area are found from the grid, only tiles with patterns larger than one cell are kept in a spatial index.
+     * \param area The area to search, in pixels.
+     * \return Row-major indices (y * width + x) of the tiles found, in drawing order.
+     */
+    QVector<int> getTilesIn(const QRect& area) const;
+
+    /*!
+     * \brief Sets the pattern of a single tile and notifies observers. Use a MapStroke to change many tiles at once.
+     */
+    void setPattern(int x, int y, int pattern);
+
+    /*!
+     * \brief Applies a list of changes as a single batch, notifying observers once.
+     * \param changes The changes to apply.
+     * \param reverse If true, restores the old pattern of each change instead (used to undo).
+     */
+    void applyChanges(const QVector<TileChange>& changes, bool reverse = false);
+
+    /*!
+     * \brief Replaces the contents of this map with those of another map, keeping this map's observers. Observers are
+     *        told that the whole map changed.
+     */
+    void replaceContents(const Map& source);
+
+    /*!
+     * \brief Adds an entity to the map. IDs are never reused, so ID order is the order entities were added in, which is
+     *        also the order they are saved in.
+     * \return The ID of the new entity.
+     */
+    int addEntity(const MapEntity& entity);
+
+    bool removeEntity(int id); /*!< Removes an entity. Returns false if no entity has the given ID. */
+
+    /*!
+     * \brief Replaces an entity, moving it in the spatial index if its bounds changed. Returns false if no entity has the
+     *        given ID.
+     */
+    bool replaceEntity(int id, const MapEntity& entity);
+
+    const MapEntity* getEntity(int id) const; /*!< Returns null if no entity has the given ID. */
+    QList<int> getEntityIds() const;          /*!< Retrieves the IDs of all entities, in ID order. */
+    inline int getEntityCount() const { return entityCount; }
+
+    /*!
+     * \brief Finds the entities whose bounds intersect an area. Only the index cells covering the area are searched.
+     * \param area The area to search, in pixels.
+     * \return The IDs of the entities found, in ID order.
+     */
+    QList<int> getEntitiesIn(const QRect& area) const;
+    QList<int> getEntitiesAt(const QPoint& point) const; /*!< Finds the entities covering a pixel, in ID order. */
+
+    /*!
+     * \brief Checks whether any entity overlaps an area (in pixels), such as a spot where something is about to be placed.
+     * \param ignore ID of an entity to leave out, -1 for none.
+     */
+    bool hasEntitiesIn(const QRect& area, int ignore = -1) const;
+
+    void addObserver(MapObserver* observer);
+    void removeObserver(MapObserver* observer);
+
+    /*!
+     * \brief Checks whether the tile at the given grid position can be walked over. Positions outside the map, and tiles
+     *        whose pattern is not found in the map's tileset, are never traversable.
+     */
+    bool isTraversable(int x, int y) const;
 
     void initTiles();
 
@@ -96,10 +216,42 @@ public:
     Object getObject();
 
 private:
+    friend class MapStroke;
+
+    void notifyTilesChanged(const QRect& area);
+
+    /*!
+     * \brief Holds an entity, or nothing once it has been removed.
+     */
+    struct EntitySlot
+    {
+        EntitySlot() : used(false) { }
+
+        MapEntity entity;
+        bool used;
+    };
+
+    /*!
+     * \brief Updates the index entry of a tile after its pattern changed.
+     * \return The area (in pixels) drawn by the tile before and after the change, if larger than its grid cell.
+     *         Null otherwise.
+     */
+    QRect indexTile(int index);
+    void rebuildTileIndex();
+    void rebuildEntityIndex();
+    QRect toTileArea(const QRect& pixels) const; /*!< Converts an area in pixels to the tiles it covers, clipped to the map. */
+
     int width, height, tileSize;
     QString name, world, music;
     Tileset* tileSet; /*!< The tileset used by this map. */
-    QVector<QVector<MapTile>> tiles; /*!< The tiles contained in this map. */
+    QVector<MapTile> tiles; /*!< The tiles contained in this map, stored row by row. */
+    QList<MapObserver*> observers; /*!< Objects notified when tiles change. */
+
+    SpatialHash tileIndex;         /*!< Bounds of the tiles whose pattern is larger than one cell, by row-major index. */
+
+    QVector<EntitySlot> entities;  /*!< The entities on this map, indexed by ID. */
+    int entityCount;               /*!< Number of slots in use. */
+    SpatialHash entityIndex;       /*!< Bounds of every entity, by ID. */
 };
 
 #endif // MAP_H
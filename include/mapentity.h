@@ -0,0 +1,76 @@
+#ifndef MAPENTITY_H
+#define MAPENTITY_H
+
+#include <QString>
+#include <QPoint>
+#include <QRect>
+
+#include "filetools.h"
+
+const int ENTITY_DEFAULT_SIZE = 16;      /*!< Size of entities that do not specify their own (such as chests and NPCs). */
+const QPoint ENTITY_DEFAULT_ORIGIN(8, 13); /*!< Position of x and y within the box of such entities. */
+
+/*!
+ * \brief Represents an entity placed on a map, other than a tile (chests, NPCs, doors, teletransporters...). Entities
+ *        keep every element they were parsed with, so types the editor does not know about are saved unchanged.
+ */
+class MapEntity
+{
+public:
+    enum Type
+    {
+        Destination,
+        Teletransporter,
+        Chest,
+        NPC,
+        Door,
+        Switch,
+        Pickable,
+        Other, /*!< Any other Solarus entity, see getTypeName. */
+        COUNT
+    };
+
+    MapEntity();
+    MapEntity(QString typeName, Object object);
+
+    static MapEntity parse(QString objectName, Object* object);
+    inline Object build() const { return object; }
+
+    inline Type getType() const           { return type; }
+    inline QString getTypeName() const    { return typeName; } /*!< The name of the entity's object in the map table. */
+    inline QString getName() const        { return object.data.value(ELE_NAME); }
+    inline int getLayer() const           { return object.data.value(ELE_LAYER, "0").toInt(); }
+    inline QPoint getPosition() const     { return QPoint(object.data.value(ELE_X, "0").toInt(), object.data.value(ELE_Y, "0").toInt()); }
+
+    /*!
+     * \brief Retrieves the area covered by the entity, in pixels. Entities with a width and height cover that size from
+     *        their position. Others cover ENTITY_DEFAULT_SIZE pixels around ENTITY_DEFAULT_ORIGIN.
+     */
+    inline QRect getBounds() const        { return bounds; }
+
+    inline QString getValue(QString element) const { return object.data.value(element); }
+    void setValue(QString element, QString value);
+    void setPosition(QPoint position);
+
+private:
+    void updateBounds();
+
+    Type type;
+    QString typeName;
+    Object object; /*!< Every element of the entity, as read from or written to the map table. */
+    QRect bounds;
+};
+
+const QString ENTITY_TYPE_STRINGS[MapEntity::Type::COUNT] =
+{
+    OBJ_DESTINATION,
+    OBJ_TELETRANSPORTER,
+    OBJ_CHEST,
+    OBJ_NPC,
+    OBJ_DOOR,
+    OBJ_SWITCH,
+    OBJ_PICKABLE,
+    ""
+}; /*!< Use ENTITY_TYPE_STRINGS to retrieve the object name of the given entity type. */
+
+#endif // MAPENTITY_H
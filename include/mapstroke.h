@@ -0,0 +1,62 @@
+#ifndef MAPSTROKE_H
+#define MAPSTROKE_H
+
+#include <QBitArray>
+#include <QRect>
+#include <QVector>
+
+#include "map.h"
+
+/*!
+ * \brief Batches brush operations on a map into a single edit.
+ *
+ * Tiles are written straight into the map's storage. The stroke remembers the original pattern of every tile it touches
+ * and the area covered, and finish() notifies the map's observers once and returns the changes so they can be undone.
+ */
+class MapStroke
+{
+public:
+    explicit MapStroke(Map* map);
+
+    /*!
+     * \brief Paints a square brush of the given size, centred on a tile.
+     */
+    void paint(int x, int y, int pattern, int size = 1);
+
+    /*!
+     * \brief Fills a rectangle (in tiles) with a pattern.
+     */
+    void fillRect(const QRect& area, int pattern);
+
+    /*!
+     * \brief Replaces the pattern of every tile connected to the given tile (horizontally or vertically) that shares its
+     *        pattern. Each tile is visited once.
+     */
+    void floodFill(int x, int y, int pattern);
+
+    /*!
+     * \brief Copies a grid of patterns onto the map with its top left corner at the given tile. Cells containing
+     *        NO_PATTERN are left untouched.
+     */
+    void stamp(int x, int y, const PatternGrid& patterns);
+
+    /*!
+     * \brief Ends the stroke, notifying the map's observers of the area changed.
+     * \return The tiles that were changed by the stroke.
+     */
+    QVector<TileChange> finish();
+
+    inline bool isEmpty() const { return changes.isEmpty(); }
+    inline QRect getDirtyRect() const { return left > right ? QRect() : QRect(QPoint(left, top), QPoint(right, bottom)); }
+
+private:
+    void write(int x, int y, int pattern);
+    void writeIndex(int index, int pattern);
+
+    Map* map;
+    QBitArray touched;            /*!< Tiles that already have an entry in changes. */
+    QVector<TileChange> changes;  /*!< The original pattern of every tile touched. */
+    int left, top, right, bottom; /*!< Bounds of the area changed, in tiles. */
+};
+
+#endif // MAPSTROKE_H
@@ -0,0 +1,88 @@
+#ifndef MAPVIEW_H
+#define MAPVIEW_H
+
+#include <QGraphicsScene>
+#include <QPainter>
+#include <QPixmap>
+#include <QCache>
+#include <QRect>
+#include <QFutureWatcher>
+#include <QVector>
+
+#include "map.h"
+
+const int MAP_CHUNK_SIZE = 16;                      /*!< Width and height of a render chunk, in tiles. */
+const int MAP_CHUNK_CACHE_SIZE = 64 * 1024;         /*!< Maximum memory used by cached chunks, in KB. */
+
+/*!
+ * \brief Scene used to display a map. Tiles are rendered from the tileset image in fixed size chunks, each cached as a
+ *        pixmap and only redrawn once a tile inside it changes. The tileset image is decoded on a worker thread, the
+ *        map is drawn once it is ready.
+ *
+ * Zoomed out, chunks are rendered from the matching level of the tileset's image pyramid, at a fraction of their full
+ * size. A whole 256x256 map then fits the cache at a quarter zoom, where full size chunks would thrash it.
+ */
+class MapView : public QGraphicsScene, public MapObserver
+{
+    Q_OBJECT
+public:
+    explicit MapView(QObject *parent = 0);
+
+    ~MapView();
+
+    void setMap(Map* map);
+    void clearMap();
+
+    /*!
+     * \brief Marks the chunk containing the given tile as out of date, so it is redrawn the next time it is exposed.
+     */
+    void invalidateTile(int x, int y);
+
+    /*!
+     * \brief Marks every chunk overlapping the given rectangle (in tiles) as out of date.
+     */
+    void invalidateRegion(const QRect& tiles);
+
+    void tilesChanged(Map* map, const QRect& area) override final;
+
+signals:
+
+public slots:
+    void drawBackground(QPainter *painter, const QRectF &rect) override final;
+
+private slots:
+    /*!
+     * \brief Retrieves the tileset image of the current map, or starts decoding it if it is not ready yet.
+     */
+    void updateTilesetImage();
+
+private:
+    /*!
+     * \brief Renders a single chunk of the map into a new pixmap, from the given level of the tileset's pyramid. The
+     *        chunk is halved in size for each level.
+     */
+    QPixmap* renderChunk(int chunkX, int chunkY, int level);
+
+    /*!
+     * \brief Retrieves the tileset image at the given pyramid level, converting it to a pixmap on first use.
+     */
+    const QPixmap& getTilesetLevel(int level);
+
+    inline int chunkKey(int chunkX, int chunkY, int level) const
+    {
+        return (level * chunksHigh + chunkY) * chunksWide + chunkX;
+    }
+
+    bool hasMap;
+
+    Map* map;
+    ImagePyramid tilesetPyramid;
+    QVector<QPixmap> tilesetLevels; /*!< Tileset image at each pyramid level, empty until the image is decoded. */
+    int chunkPixels;            /*!< Width and height of a chunk, in pixels. */
+    int chunksWide, chunksHigh; /*!< Number of chunks across and down the map. */
+
+    QCache<int,QPixmap> chunks; /*!< Rendered chunks, keyed by level and chunk index. Cost is measured in KB. */
+    QFutureWatcher<ImagePyramid> imageWatcher; /*!< Watches the decode of the tileset image. */
+};
+
+#endif // MAPVIEW_H
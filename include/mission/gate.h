@@ -21,16 +21,19 @@ public:
     Gate(QString name, Gate::Type type, QStringList keys, bool isTriggered);
     virtual ~Gate() { }
 
-    inline QString getName() { return name; }
-    inline bool isTriggered() { return triggered; }
-    inline Gate::Type getType() { return type; }
-    inline QStringList getKeys() { return keys; }
+    inline QString getName() const      { return name; }
+    inline bool isTriggered() const     { return triggered; }
+    inline Gate::Type getType() const   { return type; }
+    inline QStringList getKeys() const  { return keys; }
 
     inline void setName(const QString& name) { this->name = name; }
     inline void setTriggered(const bool& triggered) { this->triggered = triggered; }
     inline void setType(const Gate::Type& type) { this->type = type; }
     inline void setKeys(const QStringList& keys) { this->keys = keys; }
 
+    /*!
+     * \brief Parses a gate from an object. Links to keys that are not in the given list are dropped.
+     */
     static Gate Parse(Object* object, QList<Key*> keys);
     virtual Object Build();
 
@@ -28,9 +28,9 @@ public:
     Key(QString name, Key::Type type, QString message = "");
     virtual ~Key() { }
 
-    inline QString getName()    { return name; }
-    inline QString getMessage() { return message; }
-    inline Key::Type getKeyType() { return type; }
+    inline QString getName() const      { return name; }
+    inline QString getMessage() const   { return message; }
+    inline Key::Type getKeyType() const { return type; }
 
     inline void setName(const QString& name) { this->name = name; }
     inline void setMessage(const QString& message) { this->message = message; }
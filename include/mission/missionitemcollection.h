@@ -2,12 +2,18 @@
 #define MISSIONITEMCOLLECTION_H
 
 #include <QList>
+#include <QHash>
+#include <QVector>
 #include "key.h"
 #include "gate.h"
 #include "filetools.h"
 
+const int NO_MISSION_ITEM = -1; /*!< ID used for a mission item that does not exist. */
+
 /*!
  * \brief Represents a collection of mission items, specifically key events and gates, that can be used to form a mission structure.
+ *        Items are given dense numeric IDs, which stay the same until the item is removed. Names are resolved through a hash,
+ *        and each key keeps a reverse index of the gates that need it.
  */
 class MissionItemCollection
 {
@@ -16,12 +22,14 @@ public:
     virtual ~MissionItemCollection();
 
     /*!
-     * \brief Parse a mission item collection from a table.
+     * \brief Parse a mission item collection from a table. The table is kept up to date as items are added, removed or
+     *        updated.
      */
     static MissionItemCollection Parse(Table* data);
 
     /*!
-     * \brief Build the mission item collection into the given table.
+     * \brief Build the mission item collection into the given table, replacing its contents. The collection then keeps
+     *        the given table up to date.
      */
     void Build(Table* table);
 
@@ -45,41 +53,109 @@ public:
      */
     bool RemoveGate(QString name);
 
+    /*!
+     * \brief Replaces the key event with the given name. If the replacement has a different name, the key event is
+     *        renamed and every gate that needs it is updated to the new name. Returns false if the key event was not
+     *        found, or the new name is already taken by another key event.
+     */
+    bool ReplaceKeyEvent(QString name, Key key);
+
+    /*!
+     * \brief Replaces the gate with the given name, renaming it if the replacement has a different name. Returns false
+     *        if the gate was not found, or the new name is already taken by another gate.
+     */
+    bool ReplaceGate(QString name, Gate gate);
+
+    /*!
+     * \brief Retrieves the ID of the key event with the given name. Returns NO_MISSION_ITEM if key event was not found.
+     */
+    int getKeyEventId(QString name) const;
+
+    /*!
+     * \brief Retrieves the ID of the gate with the given name. Returns NO_MISSION_ITEM if gate was not found.
+     */
+    int getGateId(QString name) const;
+
     /*!
      * \brief Retrieves a pointer to the key event with the given name. Returns null pointer of key event was not found.
      */
     Key* getKeyEvent(QString name);
 
+    /*!
+     * \brief Retrieves a pointer to the key event with the given ID. Returns null pointer of key event was not found.
+     */
+    Key* getKeyEvent(int id);
+
     /*!
      * \brief Retrieves a pointer to the gate with the given name. Returns null pointer of gate was not found.
      */
     Gate* getGate(QString name);
 
+    /*!
+     * \brief Retrieves a pointer to the gate with the given ID. Returns null pointer of gate was not found.
+     */
+    Gate* getGate(int id);
 
     /*!
-     * \brief Retrieves a list of pointers to all gates in this collection.
+     * \brief Retrieves a list of pointers to all gates that need the key event with the given name.
+     */
+    QList<Gate*> getGatesRequiringKey(QString name);
+
+    /*!
+     * \brief Retrieves a list of pointers to all gates in this collection, in ID order.
      */
     QList<Gate*> getGateList();
 
     /*!
-     * \brief Retrieves a list of pointers to all key events in this collection.
+     * \brief Retrieves a list of pointers to all key events in this collection, in ID order.
      */
     QList<Key*> getKeyEventList();
 
     /*!
-     * \brief Retrieves a list of all names of key events.
+     * \brief Retrieves a list of all names of key events, in ID order.
      */
     QStringList getKeyEventNameList();
 
     /*!
-     * \brief Retrieves a list of all names of gates.
-     * \return
+     * \brief Retrieves a list of all names of gates, in ID order.
      */
     QStringList getGateNameList();
 
 private:
-    QMap<QString,Gate> gates; /*!< The gates contained in this collection. */
-    QMap<QString,Key> keyEvents; /*!< The key events contained in this collection. */
+    struct KeySlot
+    {
+        KeySlot() : object(nullptr), used(false) { }
+
+        Key key;
+        Object* object; /*!< The table object of the key event (may be null). */
+        bool used;      /*!< Whether or not the slot holds a key event, free slots are reused. */
+    };
+
+    struct GateSlot
+    {
+        GateSlot() : object(nullptr), used(false) { }
+
+        Gate gate;
+        Object* object; /*!< The table object of the gate (may be null). */
+        bool used;      /*!< Whether or not the slot holds a gate, free slots are reused. */
+    };
+
+    void linkGate(int id);         /*!< Adds a gate to the reverse index of every key it needs. */
+    void unlinkGate(int id);       /*!< Removes a gate from the reverse index of every key it needs. */
+    void writeKeyObject(int id);   /*!< Adds or rewrites the table object of a key event. */
+    void writeGateObject(int id);  /*!< Adds or rewrites the table object of a gate. */
+
+    QVector<KeySlot> keys;      /*!< The key events contained in this collection, indexed by ID. */
+    QVector<int> freeKeyIds;    /*!< IDs of unused key event slots. */
+    QHash<QString,int> keyIds;  /*!< The ID of each key event, by name. */
+
+    QVector<GateSlot> gates;    /*!< The gates contained in this collection, indexed by ID. */
+    QVector<int> freeGateIds;   /*!< IDs of unused gate slots. */
+    QHash<QString,int> gateIds; /*!< The ID of each gate, by name. */
+
+    QHash<QString,QVector<int>> keyGates; /*!< IDs of the gates that need each key, by key name. */
+
+    Table* data; /*!< The table this collection is stored in (may be null). */
 };
 
 #endif // MISSIONITEMCOLLECTION_H
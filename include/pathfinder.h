@@ -0,0 +1,94 @@
+#ifndef PATHFINDER_H
+#define PATHFINDER_H
+
+#include <QPoint>
+#include <QVector>
+#include <QList>
+
+#include "map.h"
+
+/*!
+ * \brief A walkability grid extracted from a map, used as the search space for path queries.
+ */
+class PathGrid
+{
+public:
+    PathGrid();
+    PathGrid(int width, int height);
+
+    /*!
+     * \brief Builds a grid from the traversable state of every tile in the given map.
+     */
+    static PathGrid fromMap(const Map* map);
+
+    inline int getWidth() const  { return width; }
+    inline int getHeight() const { return height; }
+
+    inline bool isWalkable(int x, int y) const
+    {
+        return x >= 0 && y >= 0 && x < width && y < height && cells[y * width + x] != 0;
+    }
+
+    inline void setWalkable(int x, int y, bool walkable) { cells[y * width + x] = walkable ? 1 : 0; }
+
+private:
+    int width, height;
+    QVector<quint8> cells; /*!< Row-major walkable flags, one byte per tile. */
+};
+
+/*!
+ * \brief A request for the path between two tile positions on a map.
+ */
+struct PathQuery
+{
+    PathQuery() : map(nullptr) { }
+    PathQuery(Map* map, QPoint start, QPoint goal) : map(map), start(start), goal(goal) { }
+
+    Map* map;     /*!< The map to search. */
+    QPoint start; /*!< Start position, in tiles. */
+    QPoint goal;  /*!< Goal position, in tiles. */
+};
+
+/*!
+ * \brief The result of a single path query.
+ */
+struct PathResult
+{
+    PathResult() : found(false), length(0.0) { }
+
+    bool found;             /*!< Whether or not the goal could be reached. */
+    qreal length;           /*!< Length of the path in tiles. Diagonal steps count as sqrt(2). */
+    QVector<QPoint> points; /*!< The jump points along the path, from start to goal inclusive. */
+};
+
+/*!
+ * \brief Finds paths over map tiles using A* with jump point search (8-directional movement, no corner cutting).
+ *
+ * Search buffers are kept per thread and reused between queries, so batches do not allocate per path.
+ */
+class Pathfinder
+{
+public:
+    /*!
+     * \brief Finds the shortest path between two positions on the given grid.
+     */
+    static PathResult findPath(const PathGrid& grid, QPoint start, QPoint goal);
+
+    /*!
+     * \brief Runs a batch of queries. Queries are grouped by map, and each map is searched on its own thread.
+     * \return The results, in the same order as the queries. Queries with a null map are skipped and get an empty
+     *         (not found) result.
+     */
+    static QVector<PathResult> findPaths(const QList<PathQuery>& queries);
+
+    /*!
+     * \brief Computes the path length between every pair of the given positions on a map.
+     * \return A row-major matrix of size points.size() * points.size(). Unreachable pairs have a length of -1.
+     */
+    static QVector<qreal> findDistances(Map* map, const QVector<QPoint>& points);
+
+private:
+    Pathfinder() { }
+};
+
+#endif // PATHFINDER_H
@@ -14,7 +14,10 @@ public:
     Preferences();
     virtual ~Preferences();
 
-    void setSolarusPath(QString solarusPath) { this->solarusPath = solarusPath; }
+    /*!
+     * \brief Sets the path of the Solarus installation, written out on the next save.
+     */
+    void setSolarusPath(QString solarusPath);
     inline QString getSolarusPath() { return solarusPath; }
 
     void saveToDisk() { data->saveToDisk(); }
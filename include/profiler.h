@@ -0,0 +1,95 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QString>
+#include <QVector>
+#include <QMutex>
+#include <QElapsedTimer>
+
+/*
+ * Lightweight instrumentation for the load, save and generation paths. Everything here is compiled out unless the
+ * project is built with PLD_PROFILE defined (qmake CONFIG+=profile), so the macros below cost nothing in normal builds.
+ *
+ *  PROFILE_SCOPE("Table::parse");        Times the enclosing scope, and counts the allocations made on its thread.
+ *  PROFILE_COUNTER("objects", count);    Records the value of a counter at this point in time.
+ *  PROFILE_THROUGHPUT("KB/s", bytes, t); Records the rate bytes were processed at since t (from Profiler::now()).
+ *
+ * The recorded events are written out as Chrome trace-event JSON, which can be opened in chrome://tracing or Perfetto.
+ */
+
+#ifdef PLD_PROFILE
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_COUNTER(name, value) Profiler::counter(name, value)
+#define PROFILE_THROUGHPUT(name, bytes, start) Profiler::throughput(name, bytes, start)
+
+/*!
+ * \brief A single trace event, either a completed scope or a counter sample.
+ */
+struct ProfileEvent
+{
+    const char* name; /*!< Must be a string literal, names are not copied. */
+    char phase;       /*!< 'X' for a completed scope, 'C' for a counter. */
+    quint64 thread;
+    qint64 start;     /*!< Microseconds since the profiler started. */
+    qint64 duration;  /*!< Microseconds, scopes only. */
+    qint64 value;     /*!< Number of allocations for scopes, the sampled value for counters. */
+    qint64 bytes;     /*!< Bytes allocated, scopes only. */
+};
+
+/*!
+ * \brief Collects trace events from every thread.
+ */
+class Profiler
+{
+public:
+    static qint64 now(); /*!< Microseconds since the profiler started. */
+
+    static void record(const ProfileEvent& event);
+    static void counter(const char* name, qint64 value);
+    static void throughput(const char* name, qint64 bytes, qint64 start); /*!< Records a counter in KB/s. */
+
+    /*!
+     * \brief Allocations made so far by the calling thread, counted by the global operator new.
+     */
+    static qint64 allocationCount();
+    static qint64 allocatedBytes();
+
+    /*!
+     * \brief Writes every event recorded so far to a trace file.
+     * \return False if the file could not be written.
+     */
+    static bool writeTrace(QString filePath);
+
+private:
+    static QMutex mutex;
+    static QVector<ProfileEvent> events;
+    static QElapsedTimer clock;
+};
+
+/*!
+ * \brief Records the time spent, and the allocations made, between its construction and destruction.
+ */
+class ProfileScope
+{
+public:
+    ProfileScope(const char* name);
+    ~ProfileScope();
+
+private:
+    const char* name;
+    qint64 start, allocations, bytes;
+};
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_COUNTER(name, value)
+#define PROFILE_THROUGHPUT(name, bytes, start)
+
+#endif // PLD_PROFILE
+
+#endif // PROFILER_H
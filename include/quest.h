@@ -3,17 +3,41 @@
 
 #include <QDir>
 #include <QFileSystemModel>
+#include <QSortFilterProxyModel>
+#include <QRegExp>
 #include <QMap>
 #include <QSharedPointer>
 #include <QList>
+#include <QImage>
 
 #include "filetools.h"
 #include "map.h"
 #include "mission.h"
+#include "questindex.h"
+#include "worldgenerator.h"
 
 // The solarus version supported by this quest object
 const QString SOLARUS_VERSION = "1.3";
 
+/*!
+ * \brief Filters a file system model down to directories and the files matching a set of name filters, optionally
+ *        limited to one subdirectory. Used so several views can share a single file system model.
+ */
+class QuestFileFilter : public QSortFilterProxyModel
+{
+public:
+    QuestFileFilter(QFileSystemModel* model, QStringList nameFilters, QString rootPath = QString());
+
+    inline QString getRootPath() const { return rootPath; }
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const override;
+
+private:
+    QVector<QRegExp> filters; /*!< Wildcard patterns that file names must match. */
+    QString rootPath;         /*!< Files outside of this path are hidden, if set. */
+};
+
 /*!
  * \brief The Quest class. Represents a quest.
  */
@@ -29,18 +53,54 @@ public:
     Quest(QString dirPath);
     virtual ~Quest();
 
-    Quest& operator=(const Quest& param);
-    Quest(const Quest& param);
+    /*!
+     * \brief Quests own their data and file system model, so they can be moved but not copied.
+     */
+    Quest(Quest&& param);
+    Quest& operator=(Quest&& param);
 
-    QFileSystemModel* getFSModel();     /*!< Retrieves the main file system model representing this quest. */
-    QFileSystemModel* getScriptModel(); /*!< Retrieves the file system model for scripts. */
-    QFileSystemModel* getMapModel();    /*!< Retrieves the file system model for maps. */
+    Quest(const Quest& param) = delete;
+    Quest& operator=(const Quest& param) = delete;
+
+    /*!
+     * \brief Retrieves the main file system model representing this quest. The model is created (and starts scanning the
+     *        quest directory) the first time it is requested.
+     */
+    QFileSystemModel* getFSModel();
+
+    QSortFilterProxyModel* getScriptModel(); /*!< Retrieves a view of the file system model showing only scripts. */
+    QSortFilterProxyModel* getMapModel();    /*!< Retrieves a view of the file system model showing only map data. */
 
     QDir getRootDir() const; /*!< Retrieves the root directory for this quest. */
 
     QDir getExecutableDir() const; /*!< Retrieves the directory from which this quest is executable through Solarus. */
 
-    bool Init(); /*!< Initializes the quest. */
+    bool Init(); /*!< Initializes the quest, loading all of its data before returning. */
+
+    /*!
+     * \brief Loads the quest header only: the quest and database tables, and the mission. Maps and tilesets are added
+     *        afterwards with addLoadedData, which lets them be loaded in the background.
+     * \return False if no quest data exists in the quest directory.
+     */
+    bool initHeader();
+
+    /*!
+     * \brief Retrieves the paths of all tilesets and maps in the quest directory (relative to the quest directory and
+     *        without extension). Tilesets are listed first.
+     */
+    QStringList getContentPaths() const;
+
+    /*!
+     * \brief Converts the path of a table relative to the quest directory into an absolute file path.
+     */
+    QString getDataFilePath(QString filePath) const;
+
+    /*!
+     * \brief Adds a tileset or map table that was parsed outside of the quest (such as on a worker thread), creating the
+     *        tileset or map it describes. The quest keeps the table.
+     * \param thumbnail Thumbnail of the tileset image (may be null). Unused for maps.
+     */
+    void addLoadedData(QString filePath, QSharedPointer<Table> table, const QImage& thumbnail = QImage());
 
     /*!
      * \brief Retrieves a table from the given filepath. If no data exists, creates a blank table to be written to the
@@ -50,6 +110,21 @@ public:
      */
     Table* getData(QString filePath);
 
+    /*!
+     * \brief Retrieves the paths of all currently loaded tables, relative to the quest directory and without extension.
+     */
+    QStringList getDataPaths() const;
+
+    /*!
+     * \brief Replaces the contents of a loaded table with a table parsed from the same file, then re-parses the map,
+     *        tileset or mission that is built from it. Maps and tilesets are patched in place, so pointers to them stay
+     *        valid.
+     * \param filePath The filepath of the table, relative to the quest directory.
+     * \param source The freshly parsed table. Its contents are moved out.
+     * \return False if no table with the given path is loaded.
+     */
+    bool reloadData(QString filePath, Table* source);
+
     /*!
      * \brief Get the name of the quest if loaded.
      * \return The name of the quest. Empty string if no quest is loaded.
@@ -112,6 +187,46 @@ public:
      */
     void addTileSet(Tileset tileset);
 
+    /*!
+     * \brief mergeTilesets Packs the patterns of several tilesets into a new tileset with a single atlas image, and moves
+     *                      every map using one of them over to the new tileset. The source tilesets are kept.
+     * \param names The names of the tilesets to merge. All of them must use the same tile size.
+     * \param newName The name of the tileset to create.
+     * \return False if a tileset is missing, the tile sizes differ, the new name or its files are already taken, or the new
+     *         tileset could not be written. Nothing is changed then.
+     */
+    bool mergeTilesets(QStringList names, QString newName);
+
+    /*!
+     * \brief getPatternUsage Counts the tiles using each pattern of a tileset, over every map using the tileset. Maps are
+     *                        counted in parallel, and their counts merged.
+     * \return Number of tiles using each pattern ID. Patterns no tile uses are left out.
+     */
+    QHash<int,int> getPatternUsage(QString tilesetName);
+
+    /*!
+     * \brief prunePatterns Removes the patterns of a tileset that no map uses, and renumbers the remaining patterns from 0.
+     *                      Maps using the tileset are updated to the new IDs and rebuilt. Nothing is saved.
+     * \return The number of patterns removed, or -1 if the tileset was not found.
+     */
+    int prunePatterns(QString tilesetName);
+
+    /*!
+     * \brief generateWorld Generates a world of several maps from the quest's mission (see WorldGenerator), adds the maps
+     *                      to the quest and lists them in the quest database. Maps are linked with teletransporters, and
+     *                      each gets an empty script. Nothing else is saved.
+     * \param backtracking Receives how far each map makes players backtrack (see WorldMap::backtracking), if not null.
+     * \return The names of the maps created, in world order. Empty if the tileset was not found, the maps are too small,
+     *         a map name is already taken, or the maps have no room left for every key event.
+     */
+    QStringList generateWorld(WorldSettings settings, QVector<qreal>* backtracking = nullptr);
+
+    /*!
+     * \brief getIndex Retrieves the search index over all loaded data, bringing it up to date first. Only tables that
+     *                 changed since the last call are re-indexed.
+     */
+    QuestIndex* getIndex();
+
     /*!
      * \brief checkForChanges Use this function to check all loaded data for differences on the disk. If there are differences, or data in the quest
      *                        does not exist on the disk, returns true.
@@ -123,11 +238,10 @@ public:
 
 private:
     QDir rootDir;
-    QFileSystemModel* fsModel;     /*!< The main file system model representing this quest. */
-    QFileSystemModel* scriptModel; /*!< The file system model representing scripts. */
-    QFileSystemModel* mapModel;    /*!< The file system model representing maps. */
-
-    void initFilters();
+    bool hasRootDir;                  /*!< Whether or not this quest has a directory, blank quests do not. */
+    QFileSystemModel* fsModel;        /*!< The main file system model representing this quest (created on demand). */
+    QuestFileFilter* scriptModel;     /*!< Filter over fsModel showing scripts (created on demand). */
+    QuestFileFilter* mapModel;        /*!< Filter over fsModel showing maps (created on demand). */
 
     QMap<QString,QSharedPointer<Table>> data; /*!< Map containing all the currently loaded data for this quest. */
 
@@ -135,7 +249,15 @@ private:
     QMap<QString,Map> maps;         /*!< The maps contained within this quest. */
     QMap<QString,Tileset> tileSets; /*!< The tilesets contained within this quest. */
 
-    void cpy(const Quest& param);
+    QuestIndex index; /*!< Search index over the loaded data, updated on demand. */
+
+    void take(Quest& param); /*!< Moves all data out of the given quest, leaving it blank. */
+
+    /*!
+     * \brief Links a map to its tileset. Maps are placed on a grid of DEFAULT_TILE_SIZE until their tileset is known,
+     *        so a map is parsed again from its table if the tileset uses another tile size.
+     */
+    void linkMap(QString name, Map& map, Tileset* tileset);
 };
 
 #endif // QUEST_H
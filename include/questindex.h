@@ -0,0 +1,79 @@
+#ifndef QUESTINDEX_H
+#define QUESTINDEX_H
+
+#include <QHash>
+#include <QStringList>
+
+#include "filetools.h"
+
+class Quest;
+
+/*!
+ * \brief An inverted index over every table loaded by a quest. Object names and element values are mapped to the tables
+ *        containing them, so questions such as "which maps use this tileset" or "where is this pattern used" are
+ *        answered without scanning the tables. Element values made of several ':' separated parts (such as a gate's key
+ *        links) are also indexed by each part.
+ *
+ * The index is brought up to date with update, which re-indexes (in parallel) only the tables whose revision changed
+ * since they were last indexed. Revisions are unique across tables, so a table replaced by another is re-indexed too.
+ * Maps are indexed as their tables were last built.
+ */
+class QuestIndex
+{
+public:
+    QuestIndex();
+
+    /*!
+     * \brief Re-indexes the quest's tables that changed since the last update, and drops tables that are not loaded.
+     */
+    void update(Quest* quest);
+
+    void clear();
+
+    /*!
+     * \brief Finds the tables containing objects of the given name.
+     * \return Paths of the tables, relative to the quest directory and without extension.
+     */
+    QStringList findObjects(QString objectName) const;
+
+    /*!
+     * \brief Finds the tables containing an object of the given name with an element set to the given value.
+     * \return Paths of the tables, relative to the quest directory and without extension.
+     */
+    QStringList find(QString objectName, QString element, QString value) const;
+
+    /*!
+     * \brief Finds the tables containing the given value in any element of any object.
+     */
+    QStringList findValue(QString value) const;
+
+    /*!
+     * \brief Counts the objects of the given name, with an element set to the given value, in one table.
+     */
+    int count(QString filePath, QString objectName, QString element, QString value) const;
+
+    QStringList getMapsUsingTileset(QString tileset) const;         /*!< Names of the maps using a tileset. */
+    QStringList getMapsUsingPattern(QString tileset, int id) const; /*!< Names of the maps using a tileset's pattern. */
+
+    /*!
+     * \brief Terms found in a single table, with the number of times each was found.
+     */
+    struct TableTerms
+    {
+        TableTerms() : revision(0) { }
+
+        quint64 revision; /*!< Revision of the table when it was indexed, unique to that table's contents. */
+        QHash<QString,int> terms;
+    };
+
+private:
+    void removeTable(const QString& filePath);
+    void addTable(const QString& filePath, const TableTerms& indexed);
+
+    QStringList lookup(const QString& term) const;
+
+    QHash<QString,TableTerms> tables;              /*!< Terms of each indexed table, by table path. */
+    QHash<QString,QHash<QString,int>> postings;    /*!< Number of occurrences in each table, by term and table path. */
+};
+
+#endif // QUESTINDEX_H
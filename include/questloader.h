@@ -0,0 +1,64 @@
+#ifndef QUESTLOADER_H
+#define QUESTLOADER_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QVector>
+#include <QSharedPointer>
+
+#include "quest.h"
+
+/*!
+ * \brief A tileset or map table (and tileset thumbnail) loaded on a worker thread.
+ */
+struct LoadedData
+{
+    QString filePath;            /*!< Path of the table, relative to the quest directory and without extension. */
+    QString dataPath;            /*!< Absolute path of the table's file. */
+    QSharedPointer<Table> table; /*!< The parsed table. Freed with the result if it never reaches the quest, such as
+                                      results a canceled load drops while they are still being read. */
+    QImage thumbnail;            /*!< Thumbnail of the tileset image, null for maps. */
+};
+
+/*!
+ * \brief Loads the tilesets and maps of a quest in the background. The quest header has to be loaded first (see
+ *        Quest::initHeader). Tables and tileset thumbnails are read on worker threads and each one is added to the
+ *        quest on the main thread as soon as it is ready, so the quest can be used while the rest of it streams in.
+ */
+class QuestLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QuestLoader(Quest* quest, QObject *parent = 0);
+
+    /*!
+     * \brief Cancels any load in progress, and waits for the tables still being read.
+     */
+    ~QuestLoader();
+
+    void start();
+
+    inline bool isRunning() const { return loader.isRunning(); }
+
+signals:
+    void progressChanged(int loaded, int total);
+    void tilesetLoaded(QString name);
+    void mapLoaded(QString name);
+    void finished(bool cancelled);
+
+public slots:
+    void cancel();
+
+private slots:
+    void resultReady(int index);
+    void loadFinished();
+
+private:
+    Quest* quest;
+    QFutureWatcher<LoadedData> loader;
+    QVector<bool> added; /*!< Whether or not each result has been added to the quest. */
+    int loaded;          /*!< Number of results added to the quest so far. */
+};
+
+#endif // QUESTLOADER_H
@@ -0,0 +1,92 @@
+#ifndef QUESTVALIDATOR_H
+#define QUESTVALIDATOR_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QPoint>
+#include <QSet>
+
+#include "quest.h"
+
+/*!
+ * \brief A problem found in a quest's data, such as a reference to something that does not exist.
+ */
+struct ValidationIssue
+{
+    enum Severity { Warning, Error };
+
+    ValidationIssue() : severity(Error), tile(-1, -1) { }
+    ValidationIssue(Severity severity, QString filePath, QString message, QPoint tile = QPoint(-1, -1)) :
+        severity(severity), filePath(filePath), message(message), tile(tile) { }
+
+    Severity severity;
+    QString filePath; /*!< Path of the table the issue was found in, relative to the quest directory and without extension. */
+    QString message;
+    QPoint tile;      /*!< Grid position of the offending tile for map issues, (-1, -1) otherwise. */
+};
+
+/*!
+ * \brief Everything needed to check one part of a quest. Copied on the main thread, so the check itself can run on a
+ *        worker thread without touching the quest.
+ */
+struct ValidationJob
+{
+    enum Kind { MapCheck, MissionCheck, DatabaseCheck };
+
+    ValidationJob() : kind(MapCheck), tilesetFound(false) { }
+
+    Kind kind;
+    QString filePath;
+
+    // Maps
+    Map map;
+    QString tilesetName;
+    bool tilesetFound;
+    QSet<int> patternIds; /*!< Patterns of the map's tileset. */
+
+    // Mission items and the quest database
+    QList<QPair<QString,Object>> objects; /*!< Copies of the table's objects, with their names. */
+    QString rootPath;                     /*!< Quest directory, resources listed in the database are looked up in it. */
+    QStringList mapNames;                 /*!< Maps loaded by the quest, which should all be listed in the database. */
+};
+
+/*!
+ * \brief Checks a whole quest for dangling references: map tilesets, tile patterns, the keys required by gates and the
+ *        resources listed in the quest database. Every map is checked as a separate task on the global thread pool, and
+ *        issues are reported as each task finishes.
+ */
+class QuestValidator : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QuestValidator(Quest* quest, QObject *parent = 0);
+
+    /*!
+     * \brief Cancels any validation in progress.
+     */
+    ~QuestValidator();
+
+    void start();
+
+    inline bool isRunning() const { return validator.isRunning(); }
+
+signals:
+    void issuesFound(QList<ValidationIssue> issues);
+    void progressChanged(int checked, int total);
+    void finished(bool cancelled);
+
+public slots:
+    void cancel();
+
+private slots:
+    void resultReady(int index);
+    void validationFinished();
+
+private:
+    Quest* quest;
+    QFutureWatcher<QList<ValidationIssue>> validator;
+    int checked; /*!< Number of tasks finished so far. */
+    int total;
+};
+
+#endif // QUESTVALIDATOR_H
@@ -0,0 +1,84 @@
+#ifndef QUESTWATCHER_H
+#define QUESTWATCHER_H
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+#include "quest.h"
+
+const int QUEST_WATCH_DEBOUNCE = 250; /*!< Time to wait for a burst of file changes to settle, in milliseconds. */
+
+/*!
+ * \brief A table re-parsed from disk, waiting to be patched into the quest.
+ */
+struct ParsedTable
+{
+    ParsedTable() : table(nullptr) { }
+    ParsedTable(QString filePath, Table* table) : filePath(filePath), table(table) { }
+
+    QString filePath; /*!< Path of the table, relative to the quest directory and without extension. */
+    Table* table;     /*!< The parsed table. Owned by the watcher until it is patched in. */
+};
+
+/*!
+ * \brief Watches the data files loaded by a quest for changes made outside the editor. Bursts of changes are collected
+ *        and, once they settle, only the affected tables are re-parsed on a worker thread. The results are patched
+ *        into the quest's maps, tilesets and mission in place, without reloading the rest of the quest.
+ *
+ * Files written by the editor itself are recognised and ignored. Tables with unsaved changes in the editor are not
+ * reloaded, conflictDetected is emitted instead.
+ */
+class QuestWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QuestWatcher(Quest* quest, QObject *parent = 0);
+    ~QuestWatcher();
+
+    /*!
+     * \brief Starts watching the file of every table currently loaded by the quest.
+     */
+    void watchLoadedData();
+
+    /*!
+     * \brief Reloads the given tables from disk, discarding any unsaved changes made to them in the editor.
+     * \param filePaths Paths of the tables, relative to the quest directory and without extension.
+     */
+    void reload(const QStringList& filePaths);
+
+signals:
+    void mapReloaded(QString name);
+    void tilesetReloaded(QString name);
+    void missionReloaded();
+    void dataReloaded(QString filePath); /*!< Emitted for every reloaded table, after any of the signals above. */
+
+    /*!
+     * \brief Emitted when tables changed on disk also have unsaved changes in the editor. They are left as they are.
+     */
+    void conflictDetected(QStringList filePaths);
+
+private slots:
+    void fileChanged(const QString& absolutePath);
+    void processPending();
+    void parseFinished();
+
+private:
+    Quest* quest;
+
+    QFileSystemWatcher watcher;
+    QHash<QString,QString> watchedPaths; /*!< Relative table path of each watched file, by absolute file path. */
+
+    QTimer debounce;       /*!< Restarted on every change, pending tables are processed once it times out. */
+    QSet<QString> pending; /*!< Tables changed since they were last processed. */
+    QSet<QString> forced;  /*!< Pending tables to reload even if they appear unchanged or have unsaved changes. */
+
+    QFutureWatcher<QList<ParsedTable>> parser;
+    bool parsing; /*!< Whether or not the parser holds results that have not been patched in yet. */
+};
+
+#endif // QUESTWATCHER_H
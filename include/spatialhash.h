@@ -0,0 +1,82 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QPoint>
+#include <QRect>
+#include <QVector>
+
+const int SPATIAL_CELL_SIZE = 64; /*!< Default width and height of a cell, in pixels. */
+
+/*!
+ * \brief Indexes rectangles by ID in a hash of fixed size square cells, for fast area and point queries. Each rectangle is
+ *        listed in every cell it overlaps. Only cells with something in them are stored, so the indexed space has no
+ *        bounds and may include negative coordinates.
+ *
+ * Cells should be a few times larger than typical rectangles: smaller cells mean more cells per rectangle, larger cells
+ * mean more rectangles checked per query.
+ */
+class SpatialHash
+{
+public:
+    explicit SpatialHash(int cellSize = SPATIAL_CELL_SIZE);
+
+    /*!
+     * \brief Adds a rectangle to the index, replacing the bounds of the ID if it is already indexed.
+     */
+    void insert(int id, const QRect& bounds);
+
+    bool remove(int id); /*!< Removes a rectangle. Returns false if the ID is not indexed. */
+
+    /*!
+     * \brief Changes the bounds of an indexed rectangle. Cells are only updated if the rectangle moves into other cells.
+     * \return False if the ID is not indexed.
+     */
+    bool move(int id, const QRect& bounds);
+
+    /*!
+     * \brief Replaces the whole index with the given rectangles. Faster than inserting them one at a time.
+     */
+    void rebuild(const QVector<QPair<int,QRect>>& items);
+
+    void clear();
+
+    inline bool contains(int id) const      { return items.contains(id); }
+    inline QRect getBounds(int id) const    { return items.value(id); } /*!< Returns a null rectangle if not indexed. */
+    inline int size() const                 { return items.size(); }
+    inline int getCellSize() const          { return cellSize; }
+
+    /*!
+     * \brief Finds the rectangles intersecting an area.
+     * \return Their IDs, in ascending order.
+     */
+    QList<int> query(const QRect& area) const;
+    QList<int> query(const QPoint& point) const; /*!< Finds the rectangles containing a point, in ascending ID order. */
+
+    /*!
+     * \brief Checks whether any rectangle intersects an area, stopping at the first one found.
+     * \param ignore ID of a rectangle to leave out (such as the one being placed), -1 for none.
+     */
+    bool intersects(const QRect& area, int ignore = -1) const;
+
+private:
+    QRect getCells(const QRect& bounds) const; /*!< Range of cells covered by a rectangle. */
+    inline static quint64 cellKey(int x, int y) { return (quint64(quint32(x)) << 32) | quint32(y); }
+
+    /*!
+     * \brief Calls visit with the ID list of every stored cell in a range, in no particular order. Iterates over the
+     *        stored cells instead of the range when that is shorter. Stops early if visit returns false.
+     */
+    template<typename Visitor> void visitCells(const QRect& range, Visitor visit) const;
+
+    void addToCells(int id, const QRect& range);
+    void removeFromCells(int id, const QRect& range);
+
+    int cellSize;
+    QHash<quint64,QVector<int>> cells; /*!< IDs of the rectangles overlapping each cell, by cell key. */
+    QHash<int,QRect> items;            /*!< Bounds of each rectangle, by ID. */
+};
+
+#endif // SPATIALHASH_H
@@ -0,0 +1,33 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QImage>
+#include <QString>
+
+/*!
+ * \brief On-disk cache of image thumbnails, keyed by a hash of the image file's contents. A cached thumbnail is reused
+ *        for as long as the file is unchanged, wherever the file is, so images only have to be decoded in full the first
+ *        time they are seen.
+ *
+ * All functions are safe to call from worker threads.
+ */
+class ThumbnailCache
+{
+public:
+    /*!
+     * \brief Retrieves the thumbnail of an image file. On a cache miss the image is decoded, an image pyramid is built
+     *        from it and its smallest level is stored in the cache.
+     * \return The thumbnail, or a null image if the file could not be read.
+     */
+    static QImage load(QString imagePath);
+
+    /*!
+     * \brief Retrieves the directory thumbnails are stored in.
+     */
+    static QString getCacheDir();
+
+private:
+    ThumbnailCache() { }
+};
+
+#endif // THUMBNAILCACHE_H
@@ -2,9 +2,16 @@
 #define TILESET_H
 
 #include <QPixmap>
+#include <QImage>
+#include <QImageReader>
 #include <QSet>
+#include <QHash>
+#include <QFuture>
 
 #include "filetools.h"
+#include "imagepyramid.h"
+
+const int NO_PATTERN = -1; /*!< Pattern ID used for grid cells that are not covered by any pattern. */
 
 struct TilePattern
 {
@@ -14,10 +21,33 @@ struct TilePattern
     static TilePattern parse(Object object);
     Object build();
 
+    /*!
+     * \brief Writes this pattern into an existing object. Elements that already mean the same thing are left untouched,
+     *        such as a ground other than "wall" on a blocking pattern.
+     * \return True if the object changed.
+     */
+    bool update(Object* object) const;
+
     int id, x, y, width, height, defaultLayer;
     bool traversable;
 };
 
+/*!
+ * \brief Grid of pattern IDs indexed by tile position within a tileset. Owns no patterns, IDs are looked up in the
+ *        tileset's pattern store.
+ */
+struct PatternGrid
+{
+    PatternGrid() : width(0), height(0) { }
+    PatternGrid(int width, int height) : width(width), height(height), ids(width * height, NO_PATTERN) { }
+
+    inline int getId(int x, int y) const    { return ids[y * width + x]; }
+    inline void setId(int x, int y, int id) { ids[y * width + x] = id; }
+
+    int width, height;
+    QVector<int> ids; /*!< Row-major pattern IDs. */
+};
+
 class Tileset
 {
 public:
@@ -25,15 +55,60 @@ public:
     Tileset(QString name, Table* data);
     virtual ~Tileset();
 
-    static Tileset create(QString name, QString filePath, Table* data, int tileSize);
+    /*!
+     * \brief Creates a tileset from an image, with one pattern per grid cell, and saves its table.
+     * \param deduplicate If true, fully transparent cells get no pattern, and cells with identical pixels share the
+     *        pattern of the first of them.
+     * \param cellPatterns If given, receives the pattern ID used by each cell (NO_PATTERN for blank cells). Cells are
+     *        numbered down each column first, the order patterns are created in without deduplication.
+     */
+    static Tileset create(QString name, QString filePath, Table* data, int tileSize, bool deduplicate = false,
+                          QMap<int,int>* cellPatterns = nullptr);
+    /*!
+     * \brief Creates a tileset by packing the patterns of several tilesets into a single atlas image, and saves its image
+     *        then its table. The sources are left untouched.
+     * \param imagePath The file to write the atlas image to.
+     * \param result Receives the new tileset.
+     * \param remap If given, receives the new ID of each source pattern, by source tileset and old pattern ID.
+     * \return False if a pattern could not be packed or a file could not be written. The table is left untouched unless
+     *         the image was written.
+     */
+    static bool createAtlas(QString name, QList<Tileset*> sources, Table* data, QString imagePath, Tileset* result,
+                            QHash<Tileset*,QMap<int,int>>* remap = nullptr);
+    /*!
+     * \brief Parses a tileset from its table. Only the header of the tileset's image is read, the image itself is decoded
+     *        the first time it is requested.
+     */
     static Tileset parse(QString name, Table* data);
+
+    /*!
+     * \brief Determines the path of a tileset's image from the path of its data file.
+     */
+    static QString getImagePath(QString name, QString dataFilePath);
+    /*!
+     * \brief Writes the tileset's patterns into its table (does not save it). Pattern objects are matched by ID and only
+     *        rewritten if their pattern changed. Other objects in the table are kept.
+     */
     static void build(Tileset tileset);
 
+    /*!
+     * \brief Writes a few patterns into their objects in the tileset's table, leaving the rest of the table untouched.
+     *        Cheaper than build when only some patterns changed.
+     */
+    void buildPatterns(const QVector<int>& ids);
+
     inline TilePattern getPattern(int id) { return patterns.find(id).value(); }
     inline void addPattern(TilePattern pattern) { patterns.insert(pattern.id, pattern); }
 
     inline QMap<int,TilePattern>* getPatterns() { return &patterns; }
-    QVector<QVector<TilePattern*>> getPatternGrid();
+
+    /*!
+     * \brief Removes every pattern not in the given set, and renumbers the remaining patterns from 0 (keeping their
+     *        order). The tileset's table is updated in place.
+     * \return The new ID of each remaining pattern, by old ID.
+     */
+    QMap<int,int> compactPatterns(const QSet<int>& keep);
+    PatternGrid getPatternGrid();
     QList<TilePattern*> getPatternList();
 
     inline QString getName() { return name; }
@@ -43,14 +118,38 @@ public:
     inline int getWidth() { return width; }
     inline int getHeight() { return height; }
 
-    inline QPixmap getImage() { return image; }
+    QPixmap getImage(); /*!< Retrieves the full tileset image, decoding it if it has not been yet. */
+
+    /*!
+     * \brief Starts decoding the tileset image on a worker thread, along with its image pyramid. Does nothing if the
+     *        image is already decoded or being decoded. getImage and getPyramid wait for the decode to finish.
+     * \return The pending decode, or a finished future if there is nothing left to decode.
+     */
+    QFuture<ImagePyramid> prefetchImage();
+    bool isImageReady(); /*!< Checks if the image can be retrieved without waiting for or doing a decode. */
+    /*!
+     * \brief Retrieves the image pyramid of the tileset image, for drawing it zoomed out. Decodes the image if it has not
+     *        been yet.
+     */
+    ImagePyramid getPyramid();
+
+    inline QImage getThumbnail() { return thumbnail; }
+    inline void setThumbnail(const QImage& thumbnail) { this->thumbnail = thumbnail; }
 
     inline void saveToDisk() { data->saveToDisk(); }
 
 private:
+    void finishDecode();
+
     Table* data;
     QString name;
+    QString imagePath; /*!< Path of the tileset's image, decoded into image on demand. */
     QPixmap image; /*!< The image representing the tileset. */
+    ImagePyramid pyramid; /*!< Halved copies of the image, level 0 is the image itself. */
+    QFuture<ImagePyramid> decoding; /*!< Decode started by prefetchImage, if any. */
+    bool prefetching; /*!< True while decoding holds a decode that has not been collected yet. */
+    bool decoded; /*!< True once the pyramid holds the decoded image (or stays empty if the image is unreadable). */
+    QImage thumbnail; /*!< Small preview of the image, may be null. */
     int tileSize; /*!< The size of each individual tile in pixels. */
     int width, height; /*!< Width and height (in tile count) of the tileset. */
     QMap<int,TilePattern> patterns; /*!< Map containing all patterns for this tileset. */
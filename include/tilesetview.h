@@ -8,6 +8,7 @@
 #include <QPainter>
 
 #include "tileset.h"
+#include "undostack.h"
 
 class TilesetView : public QGraphicsScene
 {
@@ -19,10 +20,21 @@ public:
 
     void setTileset(Tileset* tileset);
 
+    /*!
+     * \brief Stops showing a tileset, leaving the scene empty. Used before the shown tileset is deleted.
+     */
+    void clearTileset();
+
+    /*!
+     * \brief Sets the stack that changes to patterns are recorded on. Changes are not recorded if no stack is set.
+     */
+    inline void setUndoStack(UndoStack* undoStack) { this->undoStack = undoStack; }
+
 signals:
 
 public slots:
     void drawBackground(QPainter *painter, const QRectF &rect) override final;
+    void drawForeground(QPainter *painter, const QRectF &rect) override final;
     void mouseMoveEvent(QGraphicsSceneMouseEvent * mouseEvent) override final;
     void mousePressEvent(QGraphicsSceneMouseEvent *event)      override final;
     void mouseReleaseEvent(QGraphicsSceneMouseEvent *event)    override final;
@@ -38,6 +50,19 @@ private:
 
     QPoint getMouseTilePos(QPointF scenePos);
 
+    /*!
+     * \brief Gets the pattern at the given tile position, or null if no pattern covers it.
+     */
+    inline TilePattern* getPattern(int x, int y) const { return patterns[y * tileset->getWidth() + x]; }
+
+    void showSelectedTile(QPoint tilePos);
+    void hideSelectedTile();
+
+    /*!
+     * \brief Gets the area covered by the blocked marker of the given pattern.
+     */
+    QRectF getBlockedMarkerRect(const TilePattern* pattern) const;
+
     QPointF currentMousePos;
     QPoint prevTilePos;
     QPoint currentTilePos;
@@ -47,12 +72,19 @@ private:
     bool leftMouseDown;
     bool hasTileset;
 
-    QBrush blockedBrush;
-    QVector<QVector<QGraphicsRectItem*>> blockedMarkers;
+    QBrush blockedBrush; /*!< Brush used to draw markers over blocked patterns (drawn in the foreground pass). */
     QGraphicsRectItem* selectedTile;
+    bool selectedTileShown; /*!< Whether or not the selection marker is currently part of the scene. */
+
+    UndoStack* undoStack;
+    int dragId; /*!< Incremented on every mouse press, so toggles made in one drag are undone together. */
 
     Tileset* tileset;
-    QVector<QVector<TilePattern*>> patterns;
+    /*!
+     * \brief Pattern at each tile position (row-major), or null where no pattern covers it. Points into the tileset's
+     *        pattern store, so it is rebuilt whenever the tileset is set again.
+     */
+    QVector<TilePattern*> patterns;
 };
 
 #endif // TILESETVIEW_H
@@ -7,6 +7,10 @@
 #include <QFileSystemModel>
 #include <QList>
 #include <QStringListModel>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QDockWidget>
+#include <QTreeWidget>
 
 #include "common.h"
 #include "preferences.h"
@@ -16,6 +20,12 @@
 #include "editkeyevent.h"
 #include "editgatedialog.h"
 #include "questdatabase.h"
+#include "mapview.h"
+#include "undostack.h"
+#include "editcommands.h"
+#include "questwatcher.h"
+#include "questloader.h"
+#include "questvalidator.h"
 #include "quest.h"
 #include "filetools.h"
 #include "applicationdispatcher.h"
@@ -45,8 +55,12 @@ private slots:
     void on_actionClose_triggered();
     void on_actionNew_Map_triggered();
     void on_actionQuest_Database_triggered();
+    void on_actionValidate_Quest_triggered();
+    void on_actionGenerate_World_triggered();
     void on_actionRun_triggered();
     void on_actionSet_Solarus_Directory_triggered();
+    void on_actionUndo_triggered();
+    void on_actionRedo_triggered();
 
     // Key Event Buttons
     void on_newKeyEventButton_clicked();
@@ -58,19 +72,41 @@ private slots:
     void on_editGateButton_clicked();
     void on_removeGateButton_clicked();
 
+    // Space Tab
+    void on_mapSelector_currentIndexChanged(int index);
+
+    // Quest Loading
+    void questLoadProgress(int loaded, int total);
+    void questMapLoaded(QString name);
+    void questLoadFinished(bool cancelled);
+
+    // External Changes
+    void questDataReloaded(QString filePath);
+    void questTilesetReloaded(QString name);
+    void questMissionReloaded();
+    void questDataConflict(QStringList filePaths);
+
+    // Validation
+    void questIssuesFound(QList<ValidationIssue> issues);
+    void questValidationFinished(bool cancelled);
+    void issueActivated(QTreeWidgetItem* item);
+
 protected:
     void closeEvent(QCloseEvent *event) override final;
 
 private:
     void initQuestUI(); /*!< Initializes the user interface, filling it with all data loaded about the current quest. */
 
-    void updateKeyList();   /*!< Updates the event list with all data currently in the quest's mission. */
-    void updateGateList(); /*!< Updates the gate list with all data currently in the quest's mission. */
+    void updateKeyList();   /*!< Refills the event list with all data currently in the quest's mission. */
+    void updateGateList(); /*!< Refills the gate list with all data currently in the quest's mission. */
+
+    void appendListRow(QStringListModel* model, QString text); /*!< Adds a single row to the end of a list model. */
 
     Key* getSelectedKey();
     Gate* getSelectedGate();
 
     void setQuestOnlyUIEnabled(bool enabled);
+    void setQuestLoadingUI(bool loading); /*!< Shows load progress, and disables actions that need every map and tileset. */
 
     void clearRunningGame(); /*!< Clears the running game process if neccesary. */
 
@@ -82,6 +118,17 @@ private:
     Preferences preferences;
 
     Quest quest; /*!< The currently loaded quest. */
+    UndoStack* undoStack; /*!< Undo history for all edits made to the current quest. */
+    QuestWatcher* questWatcher; /*!< Reloads data files of the current quest that are changed outside the editor. */
+    QuestLoader* questLoader;   /*!< Loads the maps and tilesets of the current quest in the background. */
+    QuestValidator* questValidator; /*!< Checks the current quest for dangling references in the background. */
+
+    QProgressBar* loadProgress;   /*!< Status bar progress of the quest being loaded. */
+    QPushButton* cancelLoadButton; /*!< Status bar button cancelling the quest being loaded. */
+    QList<QAction*> fullQuestActions; /*!< List of actions only available once a quest has finished loading. */
+
+    QDockWidget* issuesDock; /*!< Dock listing the issues found by the last validation. */
+    QTreeWidget* issuesList; /*!< One row per issue: severity, file, tile and message. */
 
     QList<QAction*> questOnlyActions; /*!< List of actions only available when a quest is loaded. */
     QList<QWidget*> questOnlyWidgets; /*!< List of widgets only available when a quest is loaded. */
@@ -91,6 +138,8 @@ private:
     QStringListModel* gateModel;     /*! Model used to represent gates. */
     QStringList keyData;
     QStringList gateData;
+
+    MapView* mapScene; /*!< Scene used to display the map selected in the space tab. */
 };
 
 #endif // EDITORWINDOW_H
@@ -24,6 +24,7 @@ public:
     inline QString getName() { return name; }
     inline QString getFilePath() { return filePath; }
     inline int getTileSize() { return tileSize; }
+    inline bool isDeduplicated() { return deduplicate; }
 
 private slots:
     void on_buttonOK_clicked();
@@ -35,6 +36,7 @@ private:
 
     QString name, filePath;
     int tileSize;
+    bool deduplicate; /*!< Whether or not blank and duplicate tiles should be merged. */
 
     QPixmap tileset; /*!< The image representing the tileset. */
     QGraphicsScene* scene; /*!< The graphics scene representing the tileset. */
@@ -5,10 +5,13 @@
 #include <QStandardItemModel>
 #include <QGraphicsScene>
 #include <QCloseEvent>
+#include <QAction>
 
 #include "tilesetview.h"
 #include "newtilesetdialog.h"
 #include "quest.h"
+#include "undostack.h"
+#include "thumbnailcache.h"
 
 namespace Ui {
 class QuestDatabase;
@@ -19,15 +22,26 @@ class QuestDatabase : public QDialog
     Q_OBJECT
 
 public:
-    explicit QuestDatabase(Quest* quest, QWidget *parent = 0);
+    explicit QuestDatabase(Quest* quest, UndoStack* undoStack, QWidget *parent = 0);
     ~QuestDatabase();
 
+public slots:
+    /*!
+     * \brief Shows a tileset again after its table was reloaded, if it is the one being shown. The reload replaces its
+     *        patterns, which the tileset view points into.
+     */
+    void tilesetReloaded(QString name);
+
 private slots:
     void on_tilesetsList_doubleClicked(const QModelIndex &index);
     void on_addTilesetButton_clicked();
     void on_removeTilesetButton_clicked();
+    void on_mergeTilesetsButton_clicked();
+    void on_pruneTilesetsButton_clicked();
     void on_OKButton_clicked();
     void on_questNameEdit_editingFinished();
+    void undo();
+    void redo();
 
 private:
     void closeEvent(QCloseEvent* event) override final;
@@ -40,6 +54,7 @@ private:
     // Global
     Ui::QuestDatabase *ui;
     Quest* quest;
+    UndoStack* undoStack;
 
     // Tileset Tab
     /*!
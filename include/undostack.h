@@ -0,0 +1,96 @@
+#ifndef UNDOSTACK_H
+#define UNDOSTACK_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+
+const qint64 DEFAULT_UNDO_MEMORY_LIMIT = 32 * 1024 * 1024; /*!< Default memory cap of an undo stack, in bytes. */
+
+/*!
+ * \brief An undoable edit. Commands are pushed once their edit has been performed, and should store only what changed.
+ */
+class UndoCommand
+{
+public:
+    UndoCommand(QString text = QString()) : text(text) { }
+    virtual ~UndoCommand() { }
+
+    virtual void undo() = 0;
+    virtual void redo() = 0;
+
+    /*!
+     * \brief Commands of the same type that can be merged into one another return the same ID. -1 disables merging.
+     */
+    virtual int id() const { return -1; }
+
+    /*!
+     * \brief Attempts to absorb the given command, pushed straight after this one, into this command.
+     * \return True if the command was merged, in which case it is discarded.
+     */
+    virtual bool mergeWith(const UndoCommand* other) { Q_UNUSED(other); return false; }
+
+    /*!
+     * \brief Approximate memory used by this command, in bytes.
+     */
+    virtual qint64 cost() const = 0;
+
+    inline QString getText() const { return text; }
+
+private:
+    QString text; /*!< Description of the edit, shown in the undo and redo actions. */
+};
+
+/*!
+ * \brief A stack of undoable edits with a memory cap. When the commands on the stack use more memory than allowed, the
+ *        oldest commands are discarded.
+ */
+class UndoStack : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UndoStack(QObject *parent = 0);
+    ~UndoStack();
+
+    /*!
+     * \brief Pushes a command whose edit has already been performed. Any commands that were undone are discarded. The
+     *        stack takes ownership of the command, which may be merged into the previous command and deleted.
+     */
+    void push(UndoCommand* command);
+
+    bool canUndo() const;
+    bool canRedo() const;
+
+    QString getUndoText() const;
+    QString getRedoText() const;
+
+    /*!
+     * \brief Sets the maximum memory (in bytes) used by the commands on the stack. The most recent command is always kept.
+     */
+    void setMemoryLimit(qint64 bytes);
+
+    inline qint64 getMemoryLimit() const { return memoryLimit; }
+    inline qint64 getMemoryUsed() const  { return memoryUsed; }
+    inline int count() const             { return commands.size(); }
+
+signals:
+    void canUndoChanged(bool canUndo);
+    void canRedoChanged(bool canRedo);
+    void indexChanged(int index); /*!< Emitted whenever a command is pushed, undone or redone. */
+
+public slots:
+    void undo();
+    void redo();
+    void clear();
+
+private:
+    void trim();
+    void notify(bool couldUndo, bool couldRedo);
+
+    QList<UndoCommand*> commands;
+    QList<qint64> costs;  /*!< Cost of each command, as last measured. */
+    int index;            /*!< The number of commands currently applied. */
+    qint64 memoryUsed, memoryLimit;
+};
+
+#endif // UNDOSTACK_H
@@ -0,0 +1,129 @@
+#ifndef WORLDGENERATOR_H
+#define WORLDGENERATOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QPoint>
+
+#include "map.h"
+#include "missionitemcollection.h"
+
+const int MIN_AREA_WIDTH = 4;            /*!< Narrowest band of tiles (wall included) a mission area is given on a map. */
+const qreal WORLD_OBSTACLE_DENSITY = 0.15; /*!< Chance of each free tile off the main corridor becoming a wall. */
+
+/*!
+ * \brief Options for generating a world of several maps.
+ */
+struct WorldSettings
+{
+    WorldSettings() : mapCount(1), width(40), height(30), tileSize(DEFAULT_TILE_SIZE), seed(0), floorPattern(NO_PATTERN),
+        wallPattern(NO_PATTERN), world(DEFAULT_MAP_WORLD), music(DEFAULT_MAP_MUSIC) { }
+
+    QString prefix;   /*!< Maps are named prefix_1, prefix_2 and so on. */
+    QString tileset;  /*!< Tileset used by every map. */
+    int mapCount;     /*!< Number of maps wanted. More are made if the mission does not fit. */
+    int width;        /*!< Width of each map, in tiles. */
+    int height;       /*!< Height of each map, in tiles. */
+    int tileSize;     /*!< Size of a tile in pixels, taken from the tileset by Quest::generateWorld. */
+    uint seed;        /*!< Each map is generated from this seed and its index, so results do not depend on threading. */
+    int floorPattern; /*!< Pattern of walkable tiles, NO_PATTERN to use the tileset's first traversable pattern. */
+    int wallPattern;  /*!< Pattern of walls, NO_PATTERN to use the tileset's first blocking pattern. */
+    QString world;
+    QString music;
+};
+
+/*!
+ * \brief A section of the mission: the gate that opens it and the keys found inside it.
+ */
+struct MissionArea
+{
+    QString gate;     /*!< Gate leading into this area, empty for the area the player starts in. */
+    QStringList keys; /*!< Key events placed in this area. */
+};
+
+/*!
+ * \brief One map of a generated world: the mission areas it holds, and where its contents were placed.
+ */
+struct WorldMap
+{
+    WorldMap() : index(0), entrance(-1, -1), exit(-1, -1), routeLength(-1.0), backtracking(-1.0) { }
+
+    QString name;
+    int index;                       /*!< Position of the map in the world, maps are linked in this order. */
+    WorldSettings settings;
+    QList<MissionArea> areas;        /*!< The areas of the mission on this map, in the order they are visited. */
+
+    // Filled in by generation
+    Map map;
+    QHash<QString,QPoint> keyTiles;  /*!< Tile each key event was placed on. */
+    QStringList unplacedKeys;        /*!< Key events no reachable tile was left for. */
+    QHash<QString,QPoint> gateTiles; /*!< Tile of the opening each gate blocks. */
+    QPoint entrance;                 /*!< Tile of the teletransporter to the previous map, (-1, -1) if there is none. */
+    QPoint exit;                     /*!< Tile of the teletransporter to the next map, (-1, -1) if there is none. */
+
+    // Filled in by measure
+    qreal routeLength;  /*!< Tiles walked from the arrival point through each gate and key in mission order, then on to
+                             the exit. -1 if part of the route cannot be reached. */
+    qreal backtracking; /*!< Tiles the route walks beyond the path straight from its start to its end, -1 if unknown. */
+};
+
+/*!
+ * \brief Generates a world spanning several maps from the quest's mission. The mission is split into a chain of areas,
+ *        one per gate, and consecutive areas are spread over a chain of maps. Each map is generated on its own thread,
+ *        and consecutive maps are linked with teletransporters.
+ *
+ * Each map is laid out as vertical bands, one per area, separated by walls. A corridor runs through the middle row of
+ * the map, and gates sit where it crosses the walls between bands.
+ */
+class WorldGenerator
+{
+public:
+    /*!
+     * \brief Splits a mission into areas: the start area, then one area per gate in gate order. Each key event is placed
+     *        in the area just before the first gate needing it, so every gate can be opened with keys found before it.
+     *        Keys no gate needs are placed in the start area.
+     */
+    static QList<MissionArea> splitMission(MissionItemCollection* items);
+
+    /*!
+     * \brief Spreads the areas over settings.mapCount maps, keeping them in order. Maps without areas only link their
+     *        neighbours. If the areas do not fit, more maps are planned.
+     */
+    static QList<WorldMap> plan(const QList<MissionArea>& areas, const WorldSettings& settings);
+
+    /*!
+     * \brief Generates the tiles of every planned map and places keys and gates, one map per thread. Keys that do not fit
+     *        in their area go in an earlier area of the same map, and are listed in unplacedKeys if no tile is left.
+     * \return The generated maps, in the same order as the plans. Their tileset is not set.
+     */
+    static QList<WorldMap> generate(const QList<WorldMap>& plans);
+
+    /*!
+     * \brief Builds the teletransporters linking a generated map to its neighbours, and the destinations players
+     *        arrive at from them.
+     * \param previous Name of the previous map, empty if there is none.
+     * \param next Name of the next map, empty if there is none.
+     */
+    static QList<MapEntity> buildLinks(const WorldMap& map, QString previous, QString next);
+
+    /*!
+     * \brief Builds the entities standing for the mission on a generated map: a switch, NPC or chest on the tile of each
+     *        key event, and a door or NPC on the tile of each gate. Entities are named after their key event or gate,
+     *        and doors and chests save their state in a variable of the same name.
+     */
+    static QList<MapEntity> buildMission(const WorldMap& map, MissionItemCollection* items);
+
+    /*!
+     * \brief Measures how far players walk through a generated map: from the arrival point to each gate and key in the
+     *        order the mission visits them, then to the exit. The map's tileset must be set, it decides which tiles
+     *        can be walked on.
+     */
+    static void measure(WorldMap& map);
+
+private:
+    WorldGenerator() { }
+};
+
+#endif // WORLDGENERATOR_H
@@ -0,0 +1,112 @@
+#include "atlaspacker.h"
+
+#include <climits>
+#include <cmath>
+
+AtlasPacker::AtlasPacker(int width)
+{
+    this->width = width;
+    skyline.append(SkylineNode(0, 0, width));
+}
+
+bool AtlasPacker::fits(int index, int rectWidth, int* y) const
+{
+    if(skyline[index].x + rectWidth > width)
+        return false;
+
+    // The rectangle rests on the highest segment underneath it
+    int top = 0;
+    int remaining = rectWidth;
+    for(int i = index; remaining > 0; i++)
+    {
+        if(i == skyline.size())
+            return false;
+
+        top = qMax(top, skyline[i].y);
+        remaining -= skyline[i].width;
+    }
+
+    *y = top;
+    return true;
+}
+
+bool AtlasPacker::insert(QSize size, QPoint* position)
+{
+    int bestIndex = -1;
+    int bestY = INT_MAX;
+    int bestWidth = INT_MAX;
+
+    for(int i = 0; i < skyline.size(); i++)
+    {
+        int y;
+        if(!fits(i, size.width(), &y))
+            continue;
+
+        // Lowest position wins, ties go to the narrowest segment to leave wide gaps for wide rectangles
+        if(y < bestY || (y == bestY && skyline[i].width < bestWidth))
+        {
+            bestIndex = i;
+            bestY = y;
+            bestWidth = skyline[i].width;
+        }
+    }
+
+    if(bestIndex == -1)
+        return false;
+
+    *position = QPoint(skyline[bestIndex].x, bestY);
+    skyline.insert(bestIndex, SkylineNode(position->x(), bestY + size.height(), size.width()));
+
+    // Cut the segments now covered by the new one
+    for(int i = bestIndex + 1; i < skyline.size(); )
+    {
+        const SkylineNode& previous = skyline[i - 1];
+        int overlap = previous.x + previous.width - skyline[i].x;
+        if(overlap <= 0)
+            break;
+
+        skyline[i].x += overlap;
+        skyline[i].width -= overlap;
+
+        if(skyline[i].width <= 0)
+            skyline.remove(i);
+        else
+            break;
+    }
+
+    // Join neighbouring segments at the same height
+    for(int i = 0; i + 1 < skyline.size(); )
+    {
+        if(skyline[i].y == skyline[i + 1].y)
+        {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.remove(i + 1);
+        }
+        else
+            i++;
+    }
+
+    return true;
+}
+
+int AtlasPacker::getHeight() const
+{
+    int height = 0;
+    for(const SkylineNode& node : skyline)
+        height = qMax(height, node.y);
+    return height;
+}
+
+int AtlasPacker::suggestWidth(const QList<QSize>& sizes)
+{
+    qint64 area = 0;
+    int widest = 0;
+    for(const QSize& size : sizes)
+    {
+        area += static_cast<qint64>(size.width()) * size.height();
+        widest = qMax(widest, size.width());
+    }
+
+    int width = qMax(widest, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(area)))));
+    return (width + ATLAS_ALIGNMENT - 1) / ATLAS_ALIGNMENT * ATLAS_ALIGNMENT;
+}
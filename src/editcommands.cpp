@@ -0,0 +1,198 @@
+#include "editcommands.h"
+
+#include <algorithm>
+
+/* ------------------------------------------------------------------
+ *  MAP EDITS
+ * ------------------------------------------------------------------*/
+MapEditCommand::MapEditCommand(Map* map, QVector<TileChange> changes, QString text) :
+    UndoCommand(text)
+{
+    this->map = map;
+    changeCount = changes.size();
+
+    std::sort(changes.begin(), changes.end(), [](const TileChange& a, const TileChange& b) { return a.index < b.index; });
+
+    // Pack changes into runs of consecutive tiles sharing old and new patterns
+    for(const TileChange& change : changes)
+    {
+        if(!runs.isEmpty())
+        {
+            TileRun& last = runs.last();
+            if(last.start + last.count == change.index && last.oldPattern == change.oldPattern &&
+               last.newPattern == change.newPattern)
+            {
+                last.count++;
+                continue;
+            }
+        }
+
+        TileRun run;
+        run.start = change.index;
+        run.count = 1;
+        run.oldPattern = change.oldPattern;
+        run.newPattern = change.newPattern;
+        runs.append(run);
+    }
+
+    runs.squeeze();
+}
+
+void MapEditCommand::undo()
+{
+    apply(true);
+}
+
+void MapEditCommand::redo()
+{
+    apply(false);
+}
+
+void MapEditCommand::apply(bool reverse)
+{
+    QVector<TileChange> changes;
+    changes.reserve(changeCount);
+
+    for(const TileRun& run : runs)
+    {
+        for(int i = 0; i < run.count; i++)
+            changes.append(TileChange(run.start + i, run.oldPattern, run.newPattern));
+    }
+
+    map->applyChanges(changes, reverse);
+}
+
+qint64 MapEditCommand::cost() const
+{
+    return sizeof(*this) + runs.size() * sizeof(TileRun);
+}
+
+/* ------------------------------------------------------------------
+ *  PATTERN TOGGLES
+ * ------------------------------------------------------------------*/
+PatternToggleCommand::PatternToggleCommand(Tileset* tileset, int patternId, bool blocked, int dragId) :
+    UndoCommand(blocked ? "Block Tiles" : "Unblock Tiles")
+{
+    this->tileset = tileset;
+    this->blocked = blocked;
+    this->dragId = dragId;
+    patternIds.append(patternId);
+}
+
+void PatternToggleCommand::undo()
+{
+    apply(blocked);
+}
+
+void PatternToggleCommand::redo()
+{
+    apply(!blocked);
+}
+
+void PatternToggleCommand::apply(bool traversable)
+{
+    QMap<int,TilePattern>* patterns = tileset->getPatterns();
+    for(int id : patternIds)
+    {
+        QMap<int,TilePattern>::iterator iter = patterns->find(id);
+        if(iter != patterns->end())
+            iter.value().traversable = traversable;
+    }
+
+    tileset->buildPatterns(patternIds); // Keep the toggled patterns' objects in step, the rest of the table is untouched
+}
+
+bool PatternToggleCommand::mergeWith(const UndoCommand* other)
+{
+    const PatternToggleCommand* toggle = static_cast<const PatternToggleCommand*>(other);
+    if(toggle->tileset != tileset || toggle->dragId != dragId || toggle->blocked != blocked)
+        return false;
+
+    patternIds += toggle->patternIds;
+    return true;
+}
+
+qint64 PatternToggleCommand::cost() const
+{
+    return sizeof(*this) + patternIds.size() * sizeof(int);
+}
+
+/* ------------------------------------------------------------------
+ *  KEY EVENTS
+ * ------------------------------------------------------------------*/
+KeyEventCommand::KeyEventCommand(MissionItemCollection* items, Action action, Key oldKey, Key newKey) :
+    UndoCommand(action == Add ? "Add Key Event" : (action == Remove ? "Remove Key Event" : "Edit Key Event"))
+{
+    this->items = items;
+    this->action = action;
+    this->oldKey = oldKey;
+    this->newKey = newKey;
+}
+
+void KeyEventCommand::undo()
+{
+    if(action == Edit)
+        items->ReplaceKeyEvent(newKey.getName(), oldKey);
+    else if(action == Add)
+        items->RemoveKeyEvent(newKey.getName());
+    else
+        items->AddKeyEvent(oldKey.getName(), oldKey);
+}
+
+void KeyEventCommand::redo()
+{
+    if(action == Edit)
+        items->ReplaceKeyEvent(oldKey.getName(), newKey);
+    else if(action == Add)
+        items->AddKeyEvent(newKey.getName(), newKey);
+    else
+        items->RemoveKeyEvent(oldKey.getName());
+}
+
+qint64 KeyEventCommand::cost() const
+{
+    return sizeof(*this) + (oldKey.getName().size() + oldKey.getMessage().size() +
+                            newKey.getName().size() + newKey.getMessage().size()) * sizeof(QChar);
+}
+
+/* ------------------------------------------------------------------
+ *  GATES
+ * ------------------------------------------------------------------*/
+GateCommand::GateCommand(MissionItemCollection* items, Action action, Gate oldGate, Gate newGate) :
+    UndoCommand(action == Add ? "Add Gate" : (action == Remove ? "Remove Gate" : "Edit Gate"))
+{
+    this->items = items;
+    this->action = action;
+    this->oldGate = oldGate;
+    this->newGate = newGate;
+}
+
+void GateCommand::undo()
+{
+    if(action == Edit)
+        items->ReplaceGate(newGate.getName(), oldGate);
+    else if(action == Add)
+        items->RemoveGate(newGate.getName());
+    else
+        items->AddGate(oldGate.getName(), oldGate);
+}
+
+void GateCommand::redo()
+{
+    if(action == Edit)
+        items->ReplaceGate(oldGate.getName(), newGate);
+    else if(action == Add)
+        items->AddGate(newGate.getName(), newGate);
+    else
+        items->RemoveGate(oldGate.getName());
+}
+
+qint64 GateCommand::cost() const
+{
+    qint64 size = sizeof(*this) + (oldGate.getName().size() + newGate.getName().size()) * sizeof(QChar);
+    for(const QString& key : oldGate.getKeys())
+        size += key.size() * sizeof(QChar);
+    for(const QString& key : newGate.getKeys())
+        size += key.size() * sizeof(QChar);
+    return size;
+}
@@ -1,5 +1,283 @@
 #include "filetools.h"
 
+#include <QDebug>
+#include <QSaveFile>
+#include <atomic>
+#include <cstring>
+
+#include "profiler.h"
+
+namespace
+{
+
+const int NAME_CACHE_SIZE = 64;         /*!< Number of distinct object and element names the lexer shares strings for. */
+const int TABLE_COMPACT_THRESHOLD = 64; /*!< Removed objects a table keeps as tombstones before it considers compacting. */
+
+/*!
+ * \brief Source of table revisions, shared by every table in the process. A revision is never handed out twice, so a
+ *        revision seen on one table can never come back on another table, even one allocated at the same address.
+ */
+std::atomic<quint64> nextRevision(1);
+
+inline quint64 newRevision()
+{
+    return nextRevision.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Splits the contents of a .dat file into names, delimiters and values, working directly on its UTF-8 bytes.
+ *        Quoted values may contain delimiters, and escape sequences in them are decoded.
+ */
+class DatLexer
+{
+public:
+    DatLexer(const QByteArray& bytes) :
+        begin(bytes.constData()), pos(bytes.constData()), end(bytes.constData() + bytes.size()) { }
+
+    inline bool atEnd() const { return pos >= end; }
+    inline int offset() const { return pos - begin; }
+    inline void skip()        { if(pos < end) pos++; }
+
+    /*!
+     * \brief Skips to the start of the next line, if nothing but whitespace is left on the current one.
+     */
+    void skipLineEnd()
+    {
+        const char* next = pos;
+        while(next < end && (*next == ' ' || *next == '\t' || *next == '\r'))
+            next++;
+
+        if(next == end)
+            pos = next;
+        else if(*next == '\n')
+            pos = next + 1;
+    }
+
+    /*!
+     * \brief Skips whitespace and Lua comments.
+     */
+    void skipSpace()
+    {
+        while(pos < end)
+        {
+            if(isSpace(*pos))
+                pos++;
+            else if(*pos == '-' && pos + 1 < end && pos[1] == '-')
+            {
+                while(pos < end && *pos != '\n')
+                    pos++;
+            }
+            else
+                break;
+        }
+    }
+
+    /*!
+     * \brief Skips whitespace, then consumes the given delimiter if it comes next.
+     */
+    bool accept(char delim)
+    {
+        skipSpace();
+        if(pos < end && *pos == delim)
+        {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    /*!
+     * \brief Reads an object or element name. Names repeat throughout a file, so recently seen names share one string.
+     */
+    QString readName()
+    {
+        skipSpace();
+        const char* start = pos;
+        while(pos < end && !isSpace(*pos) && !isDelimiter(*pos))
+            pos++;
+
+        return intern(start, pos - start);
+    }
+
+    /*!
+     * \brief Reads a quoted string, or a bare value up to the next separator with surrounding whitespace removed.
+     */
+    QString readValue()
+    {
+        skipSpace();
+        if(pos < end && (*pos == STRING_QUOTE || *pos == '\''))
+            return readString();
+
+        const char* start = pos;
+        while(pos < end && *pos != VAL_SEPARATOR && *pos != OBJ_END)
+            pos++;
+
+        const char* last = pos;
+        while(last > start && isSpace(last[-1]))
+            last--;
+
+        return QString::fromUtf8(start, last - start);
+    }
+
+private:
+    static inline bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    }
+
+    static inline bool isDelimiter(char c)
+    {
+        return c == OBJ_BEGIN || c == OBJ_END || c == ELEM_ASSIGN || c == VAL_SEPARATOR || c == STRING_QUOTE || c == '\'';
+    }
+
+    QString readString()
+    {
+        const char quote = *pos++;
+        const char* start = pos;
+
+        // Fast path, values without escapes are decoded straight from the file's bytes
+        while(pos < end && *pos != quote && *pos != '\\')
+            pos++;
+
+        if(pos >= end || *pos == quote)
+        {
+            QString value = QString::fromUtf8(start, pos - start);
+            skip(); // Closing quote
+            return value;
+        }
+
+        QByteArray unescaped(start, pos - start);
+        while(pos < end && *pos != quote)
+        {
+            if(*pos == '\\' && pos + 1 < end)
+            {
+                pos++;
+                switch(*pos)
+                {
+                case 'n':   unescaped.append('\n'); break;
+                case 'r':   unescaped.append('\r'); break;
+                case 't':   unescaped.append('\t'); break;
+                default:    unescaped.append(*pos); break; // Quotes, backslashes and escaped newlines stand for themselves
+                }
+            }
+            else
+                unescaped.append(*pos);
+            pos++;
+        }
+
+        skip(); // Closing quote
+        return QString::fromUtf8(unescaped);
+    }
+
+    QString intern(const char* start, int length)
+    {
+        for(const QPair<QByteArray,QString>& name : names)
+        {
+            if(name.first.size() == length && std::memcmp(name.first.constData(), start, length) == 0)
+                return name.second;
+        }
+
+        QString name = QString::fromUtf8(start, length);
+        if(names.size() < NAME_CACHE_SIZE)
+            names.append(qMakePair(QByteArray(start, length), name));
+        return name;
+    }
+
+    const char* begin;
+    const char* pos;
+    const char* end;
+    QVector<QPair<QByteArray,QString>> names; /*!< Names seen so far, with their UTF-8 bytes. */
+};
+
+/*!
+ * \brief Appends a value as a quoted string, escaping quotes, backslashes and line breaks.
+ */
+void writeString(QByteArray& bytes, const QString& value)
+{
+    bytes.append(STRING_QUOTE);
+
+    // Fast path, most values have nothing to escape
+    const QChar* chars = value.constData();
+    bool plain = true;
+    for(int i = 0; i < value.size() && plain; i++)
+    {
+        ushort c = chars[i].unicode();
+        plain = c != STRING_QUOTE && c != '\\' && c != '\n' && c != '\r';
+    }
+
+    if(plain)
+        bytes.append(value.toUtf8());
+    else
+    {
+        for(const char c : value.toUtf8())
+        {
+            switch(c)
+            {
+            case STRING_QUOTE:  bytes.append("\\\""); break;
+            case '\\':          bytes.append("\\\\"); break;
+            case '\n':          bytes.append("\\n"); break;
+            case '\r':          bytes.append("\\r"); break;
+            default:            bytes.append(c); break;
+            }
+        }
+    }
+
+    bytes.append(STRING_QUOTE);
+}
+
+/*!
+ * \brief Appends a single element of an object.
+ */
+void writeElement(QByteArray& bytes, const QString& element, const QString& value)
+{
+    bytes.append(element.toUtf8());
+    bytes.append(" = ");
+    writeString(bytes, value);
+    bytes.append(", ");
+}
+
+/*!
+ * \brief Appends an object in the form name{element = "value", }
+ * \param order Elements listed here are written first, in the same order. Receives the order the elements were written in.
+ */
+void writeObject(QByteArray& bytes, const QString& objectName, const Object& object, QStringList& order)
+{
+    bytes.append(objectName.toUtf8());
+    bytes.append(OBJ_BEGIN);
+
+    QStringList written;
+    for(const QString& element : order)
+    {
+        ObjectData::const_iterator iter = object.data.constFind(element);
+        if(iter != object.data.constEnd())
+        {
+            writeElement(bytes, iter.key(), iter.value());
+            written.append(element);
+        }
+    }
+
+    // Elements that are new to the object follow, in alphabetical order
+    if(written.size() != object.data.size())
+    {
+        for(auto element = object.data.constBegin(); element != object.data.constEnd(); element++)
+        {
+            if(!written.contains(element.key()))
+            {
+                writeElement(bytes, element.key(), element.value());
+                written.append(element.key());
+            }
+        }
+    }
+
+    if(written != order)
+        order = written;
+
+    bytes.append(OBJ_END);
+    bytes.append('\n');
+}
+
+} // namespace
+
 void copyFolder(QString sourceDir, QString destinationDir)
 {
     QDir srcDir(sourceDir);
@@ -57,9 +335,19 @@ void Object::insert(QString element, QString value)
     data.insert(element, value);
 }
 
+bool Object::update(QString element, QString value)
+{
+    ObjectData::iterator iter = data.find(element);
+    if(iter != data.end() && iter.value() == value)
+        return false;
+
+    data.insert(element, value);
+    return true;
+}
+
 bool Object::operator==(const Object& param)
 {
-    if(data.size() != data.size())
+    if(data.size() != param.data.size())
         return false;
 
     ObjectData::iterator iterObj;
@@ -84,13 +372,36 @@ bool Object::operator!=(const Object& param)
     return !(*this == param);
 }
 
+/*!
+ * \brief An object stored in a table, along with the span of the table's source text it was read from.
+ */
+struct TableEntry : public Object
+{
+    TableEntry(QString name, Object object) :
+        Object(object), name(name), index(0), removed(false), dirty(true), sourceBegin(-1), textBegin(-1), sourceEnd(-1) { }
+
+    QString name;
+    int index;    /*!< Position in the table's list of entries. */
+    bool removed; /*!< Removed entries are left in place as tombstones until the table is compacted. */
+    bool dirty;   /*!< Whether or not the object differs from its source text. */
+
+    int sourceBegin;          /*!< Start of the text since the previous object (whitespace and comments), -1 if added. */
+    int textBegin;            /*!< Start of the object's name. */
+    int sourceEnd;            /*!< End of the object, including the line break that follows it. */
+    QStringList elementOrder; /*!< Order in which the object's elements are written. */
+};
+
 Table::Table()
 {
-    objects = QMap<QString, Object>();
     filePath = QString();
+    modified = false;
+    revision = newRevision();
+    removedCount = 0;
+    trailerBegin = 0;
+    syncSize = -1;
 }
 
-Table::Table(QString filePath)
+Table::Table(QString filePath) : Table()
 {
     this->filePath = filePath;
     parse(filePath);
@@ -98,158 +409,277 @@ Table::Table(QString filePath)
 
 Table::~Table()
 {
-
+    qDeleteAll(entries);
 }
 
 void Table::parse(QString filePath)
 {
-    // Open file and stream for reading
+    PROFILE_SCOPE("Table::parse");
+
+    // Open file and read it in one go, the parser works from memory
     file.setFileName(filePath);
     if(file.open(QIODevice::ReadOnly)) // Begin parse
     {
-        in.setDevice(&file);
-
-        // Begin parse
-        beginRead();
-
-        // Close file
-        in.flush();
+        QByteArray bytes = file.readAll();
         file.close();
+
+        parseData(bytes);
+        updateSyncState();
     }
     else
         return;
 }
 
-void Table::addObject(QString name, Object object)
+void Table::parseData(const QByteArray& bytes)
 {
-    objects.insert(name, object);
-}
+#ifdef PLD_PROFILE
+    qint64 started = Profiler::now();
+#endif
 
-Object* Table::getObject(QString objectName)
-{
-    QMap<QString,Object>::iterator iter = objects.find(objectName); // find object
+    clear();
+    sourceData = bytes;
 
-    if(iter != objects.end())
-        return &iter.value();
-    else
-        return nullptr;
+    // Objects of the same name almost always list their elements in the same order, so they share one list
+    QHash<QString,QStringList> lastOrder;
+
+    DatLexer lexer(bytes);
+    int spanBegin = 0;
+    while(true)
+    {
+        lexer.skipSpace();
+        if(lexer.atEnd())
+            break;
+
+        int textBegin = lexer.offset();
+        QString name = lexer.readName();
+        if(!lexer.accept(OBJ_BEGIN))
+        {
+            lexer.skip(); // Stray character between objects, kept as part of the text before the next object
+            continue;
+        }
+
+        // Read elements until the end of the object, objects cut off by the end of the file are dropped
+        Object object;
+        QStringList order;
+        bool closed = false;
+        while(!lexer.atEnd())
+        {
+            if(lexer.accept(OBJ_END))
+            {
+                closed = true;
+                break;
+            }
+
+            QString element = lexer.readName();
+            if(element.isEmpty() || !lexer.accept(ELEM_ASSIGN))
+            {
+                lexer.skip(); // Not an element, such as a stray separator
+                continue;
+            }
+
+            if(!object.data.contains(element))
+                order.append(element);
+            object.data.insert(element, lexer.readValue());
+            lexer.accept(VAL_SEPARATOR);
+        }
+
+        if(!closed)
+            break;
+
+        lexer.skipLineEnd();
+
+        QStringList& previous = lastOrder[name];
+        if(previous == order)
+            order = previous;
+        else
+            previous = order;
+
+        TableEntry* entry = new TableEntry(name, object);
+        entry->dirty = false;
+        entry->sourceBegin = spanBegin;
+        entry->textBegin = textBegin;
+        entry->sourceEnd = lexer.offset();
+        entry->elementOrder = order;
+        appendEntry(entry);
+
+        spanBegin = entry->sourceEnd;
+    }
+
+    trailerBegin = spanBegin;
+    modified = false;
+    revision = newRevision();
+
+    PROFILE_COUNTER("Table objects", entries.size());
+    PROFILE_THROUGHPUT("Table parse KB/s", bytes.size(), started);
 }
 
-QString Table::getElementValue(QString objectName, QString elementName)
+QByteArray Table::toData()
 {
-    Object* obj = getObject(objectName);
+#ifdef PLD_PROFILE
+    qint64 started = Profiler::now();
+#endif
 
-    if(obj != nullptr)
-       return obj->find(elementName, NULL_ELEMENT); // Find element
-    else
-        return NULL_OBJECT; // Object was not found
+    QByteArray bytes;
+    beginWrite(bytes, false);
+
+    PROFILE_THROUGHPUT("Table write KB/s", bytes.size(), started);
+    return bytes;
 }
 
-QList<Object*> Table::getObjects()
+void Table::appendEntry(TableEntry* entry)
 {
-    QList<Object*> list;
-
-    QMap<QString,Object>::iterator iter;
-    for(iter = objects.begin(); iter != objects.end(); iter++)
-            list.insert(list.size(), &iter.value());
+    entry->index = entries.size();
+    entries.append(entry);
+    lastOfName.insert(entry->name, entry);
+}
 
-    return list;
+TableEntry* Table::findEntry(Object* object) const
+{
+    // Objects handed out by the table are always entries, their index is checked to make sure they are this table's
+    TableEntry* entry = static_cast<TableEntry*>(object);
+    if(entry == nullptr || entry->index < 0 || entry->index >= entries.size() || entries[entry->index] != entry ||
+       entry->removed)
+        return nullptr;
+    return entry;
 }
 
-QList<Object*> Table::getObjectsOfName(QString objectName)
+void Table::compact()
 {
-    QList<Object*> list;
-    QMap<QString,Object>::iterator iter;
-    for(iter = objects.begin(); iter != objects.end(); iter++)
+    int live = 0;
+    for(int i = 0; i < entries.size(); i++)
     {
-        if(iter.key() == objectName)
-            list.insert(list.size(), &iter.value());
+        TableEntry* entry = entries[i];
+        if(entry->removed)
+            delete entry;
+        else
+        {
+            entry->index = live;
+            entries[live++] = entry;
+        }
     }
 
-    return list;
+    entries.resize(live);
+    removedCount = 0;
 }
 
-Object* Table::getObjectWithValue(QString objectName, QString elementName, QString value)
+Object* Table::addObject(QString name, Object object)
 {
-    auto objs = getObjectsOfName(objectName); // First, retrieve list of all objects
+    modified = true;
+    revision = newRevision();
 
-    // Search for first object with given element/value pair
-    for(int i = 0; i < objs.size(); i++)
-    {
-        ObjectData::const_iterator iter = objs[i]->data.find(elementName);
+    TableEntry* entry = new TableEntry(name, object);
+    appendEntry(entry);
+    return entry;
+}
 
-        if(iter != objs[i]->data.end())
+bool Table::removeObject(QString name, Object* object)
+{
+    TableEntry* entry = findEntry(object);
+    if(entry == nullptr || entry->name != name)
+        return false;
+
+    // The entry stays in place so other entries keep their positions, its contents are freed straight away
+    entry->removed = true;
+    entry->data.clear();
+    entry->elementOrder.clear();
+    removedCount++;
+    modified = true;
+    revision = newRevision();
+
+    // Fall back to the previous object of the same name, if this was the most recent one
+    if(lastOfName.value(name) == entry)
+    {
+        lastOfName.remove(name);
+        for(int i = entry->index - 1; i >= 0; i--)
         {
-            if(iter.value() == value)
-                return objs[i];
+            if(!entries[i]->removed && entries[i]->name == name)
+            {
+                lastOfName.insert(name, entries[i]);
+                break;
+            }
         }
     }
 
-    // if not found, return null
-    return nullptr;
+    if(removedCount > TABLE_COMPACT_THRESHOLD && removedCount * 2 > entries.size())
+        compact();
+
+    return true;
+}
+
+void Table::markDirty(Object* object)
+{
+    TableEntry* entry = findEntry(object);
+    if(entry)
+        entry->dirty = true;
+    modified = true;
+    revision = newRevision();
 }
 
-void Table::beginRead()
+Object* Table::getObject(QString objectName)
 {
-    while(file.isOpen() && !in.atEnd())
-         findObj();
+    return lastOfName.value(objectName, nullptr);
 }
 
-void Table::findObj()
+QString Table::getElementValue(QString objectName, QString elementName)
 {
-    currentObjectName = readUntil(in, FIND_OBJ_DELIMS).simplified();
+    Object* obj = getObject(objectName);
 
-    if(!in.atEnd())
-        readObj();
+    if(obj != nullptr)
+       return obj->find(elementName, NULL_ELEMENT); // Find element
     else
-        return;
+        return NULL_OBJECT; // Object was not found
 }
 
-void Table::readObj()
+QList<Object*> Table::getObjects()
 {
-    currentObject = readUntil(in ,OBJ_DELIMS).simplified();
+    QList<Object*> list;
+    list.reserve(entries.size() - removedCount);
 
-    if(!in.atEnd())
-        readElements();
-    else
-        return;
+    for(TableEntry* entry : entries)
+    {
+        if(!entry->removed)
+            list.append(entry);
+    }
+
+    return list;
 }
 
-void Table::readElements()
+QString Table::getObjectName(Object* object) const
 {
-    curObjectData = Object();
+    TableEntry* entry = findEntry(object);
+    return entry ? entry->name : QString();
+}
 
-    QTextStream str(&currentObject);
-    while(!str.atEnd())
+QList<Object*> Table::getObjectsOfName(QString objectName)
+{
+    QList<Object*> list;
+    for(TableEntry* entry : entries)
     {
-        QString element = readUntil(str, ELEM_DELIMS).simplified();
-        QString value = readUntil(str, VAL_DELIMS).simplified().remove('"');
-        curObjectData.data.insert(element, value);
+        if(!entry->removed && entry->name == objectName)
+            list.append(entry);
     }
 
-    // Build the object
-    objects.insert(currentObjectName, curObjectData);
+    return list;
 }
 
-QString Table::readUntil(QTextStream& stream, QVector<QChar> delims)
+Object* Table::getObjectWithValue(QString objectName, QString elementName, QString value)
 {
-    QString current = " ", concat = " ";
-    bool stop = false;
+    auto objs = getObjectsOfName(objectName); // First, retrieve list of all objects
 
-    while(!stop && !stream.atEnd()){
-        current = stream.read(1);
+    // Search for first object with given element/value pair
+    for(int i = 0; i < objs.size(); i++)
+    {
+        ObjectData::const_iterator iter = objs[i]->data.find(elementName);
 
-        for(int i = 0; i < delims.size(); i++)
+        if(iter != objs[i]->data.end())
         {
-            if(delims[i] == current)
-                stop = true;
+            if(iter.value() == value)
+                return objs[i];
         }
-
-        if(!stop)
-            concat.append(current);
     }
 
-    return concat;
+    // if not found, return null
+    return nullptr;
 }
 
 void Table::setFilePath(QString filePath)
@@ -271,6 +701,7 @@ bool Table::setElementValue(QString objectName, QString elementName, QString val
         if(iter != obj->data.end())
         {
             iter.value() = value;
+            markDirty(obj);
             return true;
         }
 
@@ -283,50 +714,159 @@ bool Table::setElementValue(QString objectName, QString elementName, QString val
 
 bool Table::isEmpty() const
 {
-    return objects.isEmpty();
+    return entries.size() == removedCount;
 }
 
 void Table::saveToDisk()
 {
-    file.setFileName(filePath);
-    if(file.open(QIODevice::WriteOnly)) // Begin write
-    {
-        out.setDevice(&file);
+    PROFILE_SCOPE("Table::saveToDisk");
 
-        // Write out data
-        beginWrite();
+    // Nothing to write if the file still holds exactly what the table last parsed or saved
+    if(!modified && existsOnDisk() && !changedOnDisk())
+        return;
 
-        out.flush();
-        file.close();
+    // Objects are re-based onto the new text as it is written, so the written text becomes the table's source
+    QByteArray bytes;
+    beginWrite(bytes, true);
+    sourceData = bytes;
+
+#ifdef PLD_CHECK_ROUNDTRIP
+    // Anything the format cannot represent shows up as a difference after reading the output back
+    Table parsed;
+    parsed.parseData(bytes);
+    if(!parsed.areEqual(this))
+        qWarning() << "Table round trip lost data:" << filePath;
+    else if(parsed.toData() != bytes)
+        qWarning() << "Table round trip is not stable:" << filePath;
+#endif
+
+    // The file is replaced in one go once fully written, a failed save leaves the previous file intact
+    QSaveFile saveFile(filePath);
+    if(saveFile.open(QIODevice::WriteOnly)) // Begin write
+    {
+        saveFile.write(bytes);
+        if(saveFile.commit())
+        {
+            modified = false;
+            file.setFileName(filePath);
+            updateSyncState();
+        }
     }
 }
 
+void Table::updateSyncState()
+{
+    QFileInfo info(file.fileName());
+    syncTime = info.lastModified();
+    syncSize = info.exists() ? info.size() : -1;
+}
 
-void Table::beginWrite()
+bool Table::changedOnDisk() const
 {
-    for(auto obj = objects.begin(); obj != objects.end(); obj++)
-        writeObj(obj.key(), obj.value());
+    QFileInfo info(filePath);
+    if(!info.exists())
+        return false; // Nothing to reload from
+
+    return info.size() != syncSize || info.lastModified() != syncTime;
 }
 
-void Table::writeObj(QString objectName, Object object)
+void Table::replaceContents(Table* source)
 {
-    out << objectName << "{";
-    for(auto element = object.data.begin(); element != object.data.end(); element++)
-        out << element.key() << " = \"" << element.value() << "\", ";
-    out << "}\n";
+    entries.swap(source->entries);
+    lastOfName.swap(source->lastOfName);
+    sourceData.swap(source->sourceData);
+    qSwap(removedCount, source->removedCount);
+    qSwap(trailerBegin, source->trailerBegin);
+    source->clear();
+
+    modified = false;
+    revision = newRevision();
+    syncTime = source->syncTime;
+    syncSize = source->syncSize;
+}
+
+
+void Table::beginWrite(QByteArray& bytes, bool rebase)
+{
+    // Keeps the source alive while objects are re-based onto the new text
+    const QByteArray source = sourceData;
+    bytes.reserve(source.size());
+
+    // Unchanged text is collected into runs of the source, each copied with a single append once the run is broken
+    int runBegin = -1, runEnd = -1;
+    auto flush = [&]()
+    {
+        if(runBegin >= 0 && runEnd > runBegin)
+            bytes.append(source.constData() + runBegin, runEnd - runBegin);
+        runBegin = runEnd = -1;
+    };
+    auto copy = [&](int from, int to) // Returns where the copied text starts in the output
+    {
+        if(runBegin < 0 || runEnd != from)
+        {
+            flush();
+            runBegin = runEnd = from;
+        }
+        int position = bytes.size() + runEnd - runBegin;
+        runEnd = to;
+        return position;
+    };
+
+    for(TableEntry* entry : entries)
+    {
+        if(entry->removed)
+            continue;
+
+        int begin, textBegin, end;
+
+        if(!entry->dirty && entry->sourceBegin >= 0)
+        {
+            // Unchanged objects are copied from the source as they were, along with the text before them
+            begin = copy(entry->sourceBegin, entry->sourceEnd);
+            textBegin = begin + entry->textBegin - entry->sourceBegin;
+            end = begin + entry->sourceEnd - entry->sourceBegin;
+        }
+        else
+        {
+            // Changed objects keep the text before them, and the order of their elements
+            begin = entry->sourceBegin >= 0 ? copy(entry->sourceBegin, entry->textBegin) : -1;
+            flush();
+            if(begin < 0)
+                begin = bytes.size();
+
+            textBegin = bytes.size();
+            writeObject(bytes, entry->name, *entry, entry->elementOrder);
+            end = bytes.size();
+        }
+
+        if(rebase)
+        {
+            entry->sourceBegin = begin;
+            entry->textBegin = textBegin;
+            entry->sourceEnd = end;
+            entry->dirty = false;
+        }
+    }
+
+    int trailer = copy(trailerBegin, qMax(trailerBegin, source.size()));
+    flush();
+
+    if(rebase)
+        trailerBegin = trailer;
 }
 
 bool Table::areEqual(Table* table)
 {
-    QList<Object*> otherObjs = table->getObjects();
     QList<Object*> objs = getObjects();
+    QList<Object*> otherObjs = table->getObjects();
 
     if(otherObjs.length() != objs.length())
         return false;
 
     for(int i = 0; i < objs.length(); i++)
     {
-        if(*objs[i] != *otherObjs[i])
+        if(static_cast<TableEntry*>(objs[i])->name != static_cast<TableEntry*>(otherObjs[i])->name ||
+           *objs[i] != *otherObjs[i])
             return false;
     }
 
@@ -340,19 +880,7 @@ bool Table::existsOnDisk()
 
 bool Table::operator==(Table& param)
 {
-    QList<Object*> otherObjs = param.getObjects();
-    QList<Object*> objs = getObjects();
-
-    if(otherObjs.length() != objs.length())
-        return false;
-
-    for(int i = 0; i < objs.length(); i++)
-    {
-        if(objs[0] != otherObjs[0])
-            return false;
-    }
-
-    return true;
+    return areEqual(&param);
 }
 
 bool Table::operator!=(Table& param)
@@ -362,5 +890,13 @@ bool Table::operator!=(Table& param)
 
 void Table::clear()
 {
-    objects.clear();
+    qDeleteAll(entries);
+    entries.clear();
+    lastOfName.clear();
+    removedCount = 0;
+
+    sourceData.clear();
+    trailerBegin = 0;
+    modified = true;
+    revision = newRevision();
 }
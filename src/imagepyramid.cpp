@@ -0,0 +1,37 @@
+#include "imagepyramid.h"
+
+ImagePyramid ImagePyramid::build(const QImage& image, int minSize)
+{
+    ImagePyramid pyramid;
+    if(image.isNull())
+        return pyramid;
+
+    pyramid.levels.append(image);
+
+    QImage level = image;
+    while((level.width() > minSize || level.height() > minSize) && level.width() > 1 && level.height() > 1)
+    {
+        level = level.scaled(level.width() / 2, level.height() / 2, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        pyramid.levels.append(level);
+    }
+
+    return pyramid;
+}
+
+int ImagePyramid::getLevelForScale(qreal scale) const
+{
+    int level = 0;
+    qreal levelScale = 0.5;
+    while(level + 1 < levels.size() && levelScale >= scale)
+    {
+        level++;
+        levelScale /= 2.0;
+    }
+
+    return level;
+}
+
+QImage ImagePyramid::getThumbnail() const
+{
+    return levels.isEmpty() ? QImage() : levels.last();
+}
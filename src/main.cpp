@@ -1,5 +1,6 @@
 #include "editorwindow.h"
 #include "common.h"
+#include "profiler.h"
 #include <QApplication>
 
 QString appDir;
@@ -11,5 +12,15 @@ int main(int argc, char *argv[])
     EditorWindow w;
     w.showMaximized();
 
-    return a.exec();
+    int result = a.exec();
+
+#ifdef PLD_PROFILE
+    // The trace goes to $PLD_TRACE if set, or next to the executable
+    QString tracePath = QString::fromLocal8Bit(qgetenv("PLD_TRACE"));
+    if(tracePath.isEmpty())
+        tracePath = appDir + QDir::separator() + "trace.json";
+    Profiler::writeTrace(tracePath);
+#endif
+
+    return result;
 }
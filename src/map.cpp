@@ -1,5 +1,34 @@
 #include "map.h"
 
+#include "profiler.h"
+
+#include <algorithm>
+#include <QtMath>
+
+namespace
+{
+
+/*!
+ * \brief Combines a pixel position into a single hash key.
+ */
+inline quint64 positionKey(int x, int y)
+{
+    return (quint64(quint32(x)) << 32) | quint32(y);
+}
+
+/*!
+ * \brief Builds a key identifying an entity object by its name and every element, for matching entities to objects.
+ */
+QString entityKey(const QString& objectName, const Object& object)
+{
+    QString key = objectName;
+    for(ObjectData::const_iterator iter = object.data.constBegin(); iter != object.data.constEnd(); iter++)
+        key += QChar(0x1f) + iter.key() + QChar(0x1e) + iter.value();
+    return key;
+}
+
+} // namespace
+
 Map::Map()
 {
     name = DEFAULT_MAP_NAME;
@@ -7,6 +36,8 @@ Map::Map()
     width = height = DEFAULT_MAP_SIZE;
     tileSize = DEFAULT_TILE_SIZE;
     music = DEFAULT_MAP_MUSIC;
+    tileSet = nullptr;
+    entityCount = 0;
 }
 
 Map::Map(int tileSize, int width, int height) : Map()
@@ -18,7 +49,8 @@ Map::Map(int tileSize, int width, int height) : Map()
 }
 
 Map::Map(QString name, int width, int height, int tileSize, QString music, QString world) :
-    name(name), width(width), height(height), music(music), world(world), tileSize(tileSize)
+    name(name), width(width), height(height), music(music), world(world), tileSize(tileSize), tileSet(nullptr),
+    entityCount(0)
 {
     initTiles();
 }
@@ -28,18 +60,278 @@ Map::~Map()
 
 }
 
+void Map::setTileSize(const int& size)
+{
+    tileSize = size;
+    rebuildTileIndex();
+}
+
+void Map::setTileSet(Tileset* tileSet)
+{
+    this->tileSet = tileSet;
+    rebuildTileIndex(); // Pattern sizes come from the tileset
+}
+
 void Map::setTile(int x, int y, const MapTile& tile)
 {
-    tiles[x][y] = tile;
+    tiles[y * width + x] = tile;
+    indexTile(y * width + x);
+}
+
+const MapTile& Map::getTile(int x, int y) const
+{
+    return tiles[y * width + x];
+}
+
+void Map::setPattern(int x, int y, int pattern)
+{
+    MapTile& tile = tiles[y * width + x];
+    if(tile.getPattern() != pattern)
+    {
+        tile.setPattern(pattern);
+        QRect spill = indexTile(y * width + x);
+        notifyTilesChanged(QRect(x, y, 1, 1) | toTileArea(spill));
+    }
+}
+
+void Map::applyChanges(const QVector<TileChange>& changes, bool reverse)
+{
+    if(changes.isEmpty())
+        return;
+
+    int left = width, top = height, right = -1, bottom = -1;
+    QRect spill; // Pixels drawn by changed tiles outside their own cell
+    for(const TileChange& change : changes)
+    {
+        tiles[change.index].setPattern(reverse ? change.oldPattern : change.newPattern);
+        spill |= indexTile(change.index);
+
+        int x = change.index % width;
+        int y = change.index / width;
+        left = qMin(left, x);
+        top = qMin(top, y);
+        right = qMax(right, x);
+        bottom = qMax(bottom, y);
+    }
+
+    notifyTilesChanged(QRect(QPoint(left, top), QPoint(right, bottom)) | toTileArea(spill));
+}
+
+void Map::replaceContents(const Map& source)
+{
+    QList<MapObserver*> keep = observers;
+    *this = source;
+    observers = keep;
+
+    notifyTilesChanged(QRect(0, 0, width, height));
+}
+
+int Map::addEntity(const MapEntity& entity)
+{
+    EntitySlot slot;
+    slot.entity = entity;
+    slot.used = true;
+    entities.append(slot);
+    entityCount++;
+
+    entityIndex.insert(entities.size() - 1, entity.getBounds());
+    return entities.size() - 1;
+}
+
+bool Map::removeEntity(int id)
+{
+    if(getEntity(id) == nullptr)
+        return false;
+
+    entityIndex.remove(id);
+    entities[id] = EntitySlot();
+    entityCount--;
+    return true;
+}
+
+bool Map::replaceEntity(int id, const MapEntity& entity)
+{
+    if(getEntity(id) == nullptr)
+        return false;
+
+    entities[id].entity = entity;
+    entityIndex.move(id, entity.getBounds());
+    return true;
+}
+
+const MapEntity* Map::getEntity(int id) const
+{
+    if(id < 0 || id >= entities.size() || !entities[id].used)
+        return nullptr;
+    return &entities[id].entity;
+}
+
+QList<int> Map::getEntityIds() const
+{
+    QList<int> ids;
+    for(int id = 0; id < entities.size(); id++)
+    {
+        if(entities[id].used)
+            ids.append(id);
+    }
+    return ids;
+}
+
+QList<int> Map::getEntitiesIn(const QRect& area) const
+{
+    return entityIndex.query(area);
+}
+
+QList<int> Map::getEntitiesAt(const QPoint& point) const
+{
+    return entityIndex.query(point);
+}
+
+bool Map::hasEntitiesIn(const QRect& area, int ignore) const
+{
+    return entityIndex.intersects(area, ignore);
+}
+
+QRect Map::getTileBounds(int x, int y) const
+{
+    QRect bounds(x * tileSize, y * tileSize, tileSize, tileSize);
+    if(tileSet == nullptr)
+        return bounds;
+
+    QMap<int,TilePattern>* patterns = tileSet->getPatterns();
+    QMap<int,TilePattern>::const_iterator iter = patterns->constFind(tiles[y * width + x].getPattern());
+    if(iter != patterns->constEnd())
+        bounds.setSize(QSize(iter.value().width, iter.value().height));
+
+    return bounds;
+}
+
+QVector<int> Map::getTilesIn(const QRect& area) const
+{
+    QVector<int> found;
+    QRect cells = toTileArea(area);
+    if(cells.isEmpty())
+        return found;
+
+    found.reserve(cells.width() * cells.height());
+    for(int y = cells.top(); y <= cells.bottom(); y++)
+    {
+        for(int x = cells.left(); x <= cells.right(); x++)
+            found.append(y * width + x);
+    }
+
+    // Large tiles starting outside the area can still be drawn over it
+    bool spilled = false;
+    for(int index : tileIndex.query(area))
+    {
+        if(!cells.contains(index % width, index / width))
+        {
+            found.append(index);
+            spilled = true;
+        }
+    }
+    if(spilled)
+        std::sort(found.begin(), found.end());
+
+    return found;
+}
+
+QRect Map::indexTile(int index)
+{
+    QRect before = tileIndex.getBounds(index);
+    QRect after = getTileBounds(index % width, index / width);
+
+    if(after.width() > tileSize || after.height() > tileSize)
+    {
+        tileIndex.insert(index, after);
+        return before | after;
+    }
+
+    if(!before.isNull())
+        tileIndex.remove(index);
+    return before;
+}
+
+void Map::rebuildTileIndex()
+{
+    QVector<QPair<int,QRect>> large;
+    if(tileSet != nullptr)
+    {
+        for(int y = 0; y < height; y++)
+        {
+            for(int x = 0; x < width; x++)
+            {
+                QRect bounds = getTileBounds(x, y);
+                if(bounds.width() > tileSize || bounds.height() > tileSize)
+                    large.append(qMakePair(y * width + x, bounds));
+            }
+        }
+    }
+
+    tileIndex.rebuild(large);
+}
+
+void Map::rebuildEntityIndex()
+{
+    QVector<QPair<int,QRect>> bounds;
+    bounds.reserve(entityCount);
+    for(int id = 0; id < entities.size(); id++)
+    {
+        if(entities[id].used)
+            bounds.append(qMakePair(id, entities[id].entity.getBounds()));
+    }
+
+    entityIndex.rebuild(bounds);
+}
+
+QRect Map::toTileArea(const QRect& pixels) const
+{
+    if(pixels.isEmpty() || tileSize <= 0)
+        return QRect();
+
+    QRect tileArea(QPoint(qFloor(pixels.left() / qreal(tileSize)), qFloor(pixels.top() / qreal(tileSize))),
+                   QPoint(qFloor(pixels.right() / qreal(tileSize)), qFloor(pixels.bottom() / qreal(tileSize))));
+    return tileArea & QRect(0, 0, width, height);
+}
+
+void Map::addObserver(MapObserver* observer)
+{
+    if(!observers.contains(observer))
+        observers.append(observer);
+}
+
+void Map::removeObserver(MapObserver* observer)
+{
+    observers.removeAll(observer);
+}
+
+void Map::notifyTilesChanged(const QRect& area)
+{
+    for(MapObserver* observer : observers)
+        observer->tilesChanged(this, area);
 }
 
-const MapTile& Map::getTile(int x, int y)
+bool Map::isTraversable(int x, int y) const
 {
-    return tiles[x][y];
+    if(x < 0 || y < 0 || x >= width || y >= height)
+        return false;
+
+    if(tileSet == nullptr) // Without a tileset there is nothing to block movement
+        return true;
+
+    QMap<int,TilePattern>* patterns = tileSet->getPatterns();
+    QMap<int,TilePattern>::const_iterator iter = patterns->constFind(tiles[y * width + x].getPattern());
+
+    if(iter != patterns->constEnd())
+        return iter.value().traversable;
+    else
+        return false;
 }
 
-Map Map::parse(QString name, Table* data)
+Map Map::parse(QString name, Table* data, int tileSize)
 {
+    PROFILE_SCOPE("Map::parse");
+
     Map map;
 
     Object* properties = data->getObject(OBJ_PROPERTIES);
@@ -47,21 +339,39 @@ Map Map::parse(QString name, Table* data)
         return Map(); // If properties not found, return a blank map
     else
     {
-        // Read in map properties (sets defaults if not found)
-        map = Map(properties->find(ELE_TILE_SIZE, QString::number(DEFAULT_TILE_SIZE)).toInt(),
-                  properties->find(ELE_WIDTH, QString::number(DEFAULT_MAP_SIZE)).toInt(),
-                  properties->find(ELE_HEIGHT, QString::number(DEFAULT_MAP_SIZE)).toInt());
+        // Read in map properties (sets defaults if not found). Sizes are stored in pixels.
+        if(tileSize <= 0)
+            tileSize = DEFAULT_TILE_SIZE;
+        map = Map(tileSize,
+                  properties->find(ELE_WIDTH, QString::number(DEFAULT_MAP_SIZE)).toInt() / tileSize,
+                  properties->find(ELE_HEIGHT, QString::number(DEFAULT_MAP_SIZE)).toInt() / tileSize);
         map.setName(name);
         map.setMusic(properties->find(ELE_MUSIC, DEFAULT_MAP_MUSIC));
+        map.world = properties->find(ELE_WORLD, DEFAULT_MAP_WORLD);
 
-
-        // Read in the tile grid, and put into the internal collection of tiles
-        QList<Object*> mapTiles = data->getObjectsOfName(OBJ_TILE);
-        for(auto t : mapTiles)
+        // Read in the tile grid and every other entity, in file order. Tiles are positioned in pixels, but kept in grid
+        // coordinates.
+        for(Object* object : data->getObjects())
         {
-            MapTile tile = MapTile::parse(t);
-            map.setTile(tile.getX()/map.getTileSize(), tile.getY()/map.getTileSize(), tile);
+            QString objectName = data->getObjectName(object);
+            if(objectName == OBJ_TILE)
+            {
+                MapTile tile = MapTile::parse(object);
+                tile.setX(tile.getX() / tileSize);
+                tile.setY(tile.getY() / tileSize);
+                if(tile.getX() >= 0 && tile.getY() >= 0 && tile.getX() < map.width && tile.getY() < map.height)
+                    map.setTile(tile.getX(), tile.getY(), tile);
+            }
+            else if(objectName != OBJ_PROPERTIES)
+            {
+                EntitySlot slot;
+                slot.entity = MapEntity::parse(objectName, object);
+                slot.used = true;
+                map.entities.append(slot);
+                map.entityCount++;
+            }
         }
+        map.rebuildEntityIndex(); // Indexed in bulk, once every entity is read
 
         return map;
     }
@@ -69,31 +379,103 @@ Map Map::parse(QString name, Table* data)
 
 void Map::initTiles()
 {
-    tiles = QVector<QVector<MapTile>>(width, QVector<MapTile>(height));
+    tiles = QVector<MapTile>(width * height);
+    for(int i = 0; i < tiles.size(); i++)
+        tiles[i] = MapTile(0, i % width, i / width, tileSize, 0);
+    tileIndex.clear();
 }
 
 void Map::build(Table* table)
 {
-    table->clear(); // Clear the existing table
+    PROFILE_SCOPE("Map::build");
+
+    // Objects already in the table are updated in place, and only marked dirty if they changed. Saving after a small
+    // edit then only rewrites the objects of the edited tiles.
+    Object* properties = table->getObject(OBJ_PROPERTIES);
+    if(properties == nullptr)
+        properties = table->addObject(OBJ_PROPERTIES, Object());
+
+    bool changed = properties->update(ELE_X, QString::number(0));
+    changed |= properties->update(ELE_Y, QString::number(0));
+    changed |= properties->update(ELE_WIDTH, QString::number(width * tileSize));
+    changed |= properties->update(ELE_HEIGHT, QString::number(height * tileSize));
+    changed |= properties->update(ELE_WORLD, world);
+    changed |= properties->update(ELE_MUSIC, music);
+    changed |= properties->update(ELE_TILESET, tileSet->getName());
+    if(changed)
+        table->markDirty(properties);
 
-    // Construct the properties object
-    Object properties = Object();
-    properties.insert(ELE_X, QString::number(0));
-    properties.insert(ELE_Y, QString::number(0));
-    properties.insert(ELE_WIDTH, QString::number(width * tileSize));
-    properties.insert(ELE_HEIGHT, QString::number(height * tileSize));
-    properties.insert(ELE_WORLD, world);
-    properties.insert(ELE_MUSIC, music);
-    properties.insert(ELE_TILESET, tileSet->getName());
+    // Tiles are matched with their objects by position. Parsing keeps the last tile at each position, so earlier
+    // duplicates are dropped.
+    QHash<quint64,Object*> tileObjects;
+    for(Object* object : table->getObjectsOfName(OBJ_TILE))
+    {
+        Object*& slot = tileObjects[positionKey(object->find(ELE_X, "0").toInt(), object->find(ELE_Y, "0").toInt())];
+        if(slot != nullptr)
+            table->removeObject(OBJ_TILE, slot);
+        slot = object;
+    }
+
+    QMap<int,TilePattern>* patterns = tileSet->getPatterns();
+    for(MapTile tile : tiles)
+    {
+        // Tiles keep the size they were read with while it still fits their pattern, and take the pattern's size once
+        // they are painted with a pattern it does not fit
+        QMap<int,TilePattern>::const_iterator pattern = patterns->constFind(tile.getPattern());
+        if(pattern != patterns->constEnd() && pattern.value().width > 0 && pattern.value().height > 0 &&
+           (tile.getWidth() <= 0 || tile.getWidth() % pattern.value().width != 0 ||
+            tile.getHeight() <= 0 || tile.getHeight() % pattern.value().height != 0))
+        {
+            tile.setWidth(pattern.value().width);
+            tile.setHeight(pattern.value().height);
+        }
+
+        Object built = MapTile::build(tile, tileSize);
+        Object* object = tileObjects.take(positionKey(tile.getX() * tileSize, tile.getY() * tileSize));
+        if(object == nullptr)
+        {
+            table->addObject(OBJ_TILE, built);
+            continue;
+        }
 
-    // Add properties to the table
-    table->addObject(OBJ_PROPERTIES, properties);
+        bool tileChanged = false;
+        for(ObjectData::const_iterator element = built.data.constBegin(); element != built.data.constEnd(); element++)
+            tileChanged |= object->update(element.key(), element.value());
+        if(tileChanged)
+            table->markDirty(object);
+    }
+
+    // Tiles outside the map
+    for(Object* object : tileObjects)
+        table->removeObject(OBJ_TILE, object);
+
+    // Entities are matched by type and contents. Unchanged entities keep their place in the file, changed ones are
+    // replaced by new objects after everything else.
+    QHash<QString,QList<Object*>> entityObjects;
+    for(Object* object : table->getObjects())
+    {
+        QString objectName = table->getObjectName(object);
+        if(objectName != OBJ_TILE && objectName != OBJ_PROPERTIES)
+            entityObjects[entityKey(objectName, *object)].append(object);
+    }
+
+    for(const EntitySlot& slot : entities)
+    {
+        if(!slot.used)
+            continue;
+
+        Object built = slot.entity.build();
+        QList<Object*>& matches = entityObjects[entityKey(slot.entity.getTypeName(), built)];
+        if(matches.isEmpty())
+            table->addObject(slot.entity.getTypeName(), built);
+        else
+            matches.removeFirst();
+    }
 
-    // Construct all tile objects, and add them to the table
-    for(int y = 0; y < height; y++)
+    for(const QList<Object*>& unmatched : entityObjects)
     {
-        for(int x = 0; x < width; x++)
-            table->addObject(OBJ_TILE, MapTile::build(tiles[x][y]));
+        for(Object* object : unmatched)
+            table->removeObject(table->getObjectName(object), object);
     }
 }
 
@@ -101,7 +483,8 @@ MapTile MapTile::parse(Object* object)
 {
     MapTile mapTile;
 
-    mapTile.setSize     (object->find(ELE_WIDTH, QString::number(DEFAULT_TILE_SIZE)).toInt());
+    mapTile.setWidth    (object->find(ELE_WIDTH, QString::number(DEFAULT_TILE_SIZE)).toInt());
+    mapTile.setHeight   (object->find(ELE_HEIGHT, QString::number(DEFAULT_TILE_SIZE)).toInt());
     mapTile.setX        (object->find(ELE_X, "0").toInt());
     mapTile.setY        (object->find(ELE_Y, "0").toInt());
     mapTile.setLayer    (object->find(ELE_LAYER, "0").toInt());
@@ -110,15 +493,15 @@ MapTile MapTile::parse(Object* object)
     return mapTile;
 }
 
-Object MapTile::build(MapTile tile)
+Object MapTile::build(MapTile tile, int tileSize)
 {
     Object object = Object();
 
-    object.insert(ELE_HEIGHT,   QString::number(tile.getSize()));
-    object.insert(ELE_WIDTH,    QString::number(tile.getSize()));
+    object.insert(ELE_HEIGHT,   QString::number(tile.getHeight()));
+    object.insert(ELE_WIDTH,    QString::number(tile.getWidth()));
     object.insert(ELE_PATTERN,  QString::number(tile.getPattern()));
-    object.insert(ELE_X,        QString::number(tile.getX() * tile.getSize()));
-    object.insert(ELE_Y,        QString::number(tile.getY() * tile.getSize()));
+    object.insert(ELE_X,        QString::number(tile.getX() * tileSize));
+    object.insert(ELE_Y,        QString::number(tile.getY() * tileSize));
     object.insert(ELE_LAYER,    QString::number(tile.getLayer()));
 
     return object;
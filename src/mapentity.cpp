@@ -0,0 +1,50 @@
+#include "mapentity.h"
+
+MapEntity::MapEntity()
+{
+    type = Other;
+    updateBounds();
+}
+
+MapEntity::MapEntity(QString typeName, Object object)
+{
+    this->typeName = typeName;
+    this->object = object;
+
+    type = Other;
+    for(int i = 0; i < Other; i++)
+    {
+        if(ENTITY_TYPE_STRINGS[i] == typeName)
+            type = static_cast<Type>(i);
+    }
+
+    updateBounds();
+}
+
+MapEntity MapEntity::parse(QString objectName, Object* object)
+{
+    return MapEntity(objectName, *object);
+}
+
+void MapEntity::setValue(QString element, QString value)
+{
+    object.insert(element, value);
+    updateBounds();
+}
+
+void MapEntity::setPosition(QPoint position)
+{
+    object.insert(ELE_X, QString::number(position.x()));
+    object.insert(ELE_Y, QString::number(position.y()));
+    updateBounds();
+}
+
+void MapEntity::updateBounds()
+{
+    QPoint position = getPosition();
+
+    if(object.data.contains(ELE_WIDTH) && object.data.contains(ELE_HEIGHT))
+        bounds = QRect(position.x(), position.y(), object.data.value(ELE_WIDTH).toInt(), object.data.value(ELE_HEIGHT).toInt());
+    else
+        bounds = QRect(position - ENTITY_DEFAULT_ORIGIN, QSize(ENTITY_DEFAULT_SIZE, ENTITY_DEFAULT_SIZE));
+}
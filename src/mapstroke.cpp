@@ -0,0 +1,147 @@
+#include "mapstroke.h"
+
+#include <climits>
+
+MapStroke::MapStroke(Map* map)
+{
+    this->map = map;
+    touched = QBitArray(map->width * map->height);
+    left = top = INT_MAX;
+    right = bottom = -1;
+}
+
+void MapStroke::write(int x, int y, int pattern)
+{
+    if(x >= 0 && y >= 0 && x < map->width && y < map->height)
+        writeIndex(y * map->width + x, pattern);
+}
+
+void MapStroke::writeIndex(int index, int pattern)
+{
+    MapTile& tile = map->tiles[index];
+    if(tile.getPattern() == pattern)
+        return;
+
+    if(!touched.testBit(index))
+    {
+        touched.setBit(index);
+        changes.append(TileChange(index, tile.getPattern(), pattern));
+
+        int x = index % map->width;
+        int y = index / map->width;
+        left = qMin(left, x);
+        top = qMin(top, y);
+        right = qMax(right, x);
+        bottom = qMax(bottom, y);
+    }
+
+    tile.setPattern(pattern);
+}
+
+void MapStroke::paint(int x, int y, int pattern, int size)
+{
+    fillRect(QRect(x - size/2, y - size/2, size, size), pattern);
+}
+
+void MapStroke::fillRect(const QRect& area, int pattern)
+{
+    QRect bounded = area.intersected(QRect(0, 0, map->width, map->height));
+
+    for(int y = bounded.top(); y <= bounded.bottom(); y++)
+    {
+        int row = y * map->width;
+        for(int x = bounded.left(); x <= bounded.right(); x++)
+            writeIndex(row + x, pattern);
+    }
+}
+
+void MapStroke::floodFill(int x, int y, int pattern)
+{
+    const int width = map->width;
+    const int height = map->height;
+
+    if(x < 0 || y < 0 || x >= width || y >= height)
+        return;
+
+    const int target = map->tiles[y * width + x].getPattern();
+    if(target == pattern)
+        return;
+
+    // Scanline fill: filled tiles no longer match the target, so every tile is written at most once
+    QVector<QPoint> seeds;
+    seeds.append(QPoint(x, y));
+
+    while(!seeds.isEmpty())
+    {
+        QPoint seed = seeds.takeLast();
+        int row = seed.y() * width;
+
+        if(map->tiles[row + seed.x()].getPattern() != target)
+            continue;
+
+        // Extend the run as far as possible in both directions
+        int runLeft = seed.x();
+        int runRight = seed.x();
+        while(runLeft > 0 && map->tiles[row + runLeft - 1].getPattern() == target)
+            runLeft--;
+        while(runRight < width - 1 && map->tiles[row + runRight + 1].getPattern() == target)
+            runRight++;
+
+        for(int i = runLeft; i <= runRight; i++)
+            writeIndex(row + i, pattern);
+
+        // Queue one seed for each run of matching tiles in the rows above and below
+        for(int nextY = seed.y() - 1; nextY <= seed.y() + 1; nextY += 2)
+        {
+            if(nextY < 0 || nextY >= height)
+                continue;
+
+            int nextRow = nextY * width;
+            bool inRun = false;
+            for(int i = runLeft; i <= runRight; i++)
+            {
+                bool matches = map->tiles[nextRow + i].getPattern() == target;
+                if(matches && !inRun)
+                    seeds.append(QPoint(i, nextY));
+                inRun = matches;
+            }
+        }
+    }
+}
+
+void MapStroke::stamp(int x, int y, const PatternGrid& patterns)
+{
+    for(int stampY = 0; stampY < patterns.height; stampY++)
+    {
+        for(int stampX = 0; stampX < patterns.width; stampX++)
+        {
+            int id = patterns.getId(stampX, stampY);
+            if(id != NO_PATTERN)
+                write(x + stampX, y + stampY, id);
+        }
+    }
+}
+
+QVector<TileChange> MapStroke::finish()
+{
+    // Record final patterns, dropping tiles that were painted back to what they started as
+    QVector<TileChange> result;
+    result.reserve(changes.size());
+    for(const TileChange& change : changes)
+    {
+        int current = map->tiles[change.index].getPattern();
+        if(current != change.oldPattern)
+            result.append(TileChange(change.index, change.oldPattern, current));
+    }
+
+    if(!changes.isEmpty())
+        map->notifyTilesChanged(getDirtyRect());
+
+    // Reset, so the stroke can be reused
+    changes.clear();
+    touched.fill(false);
+    left = top = INT_MAX;
+    right = bottom = -1;
+
+    return result;
+}
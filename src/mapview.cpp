@@ -0,0 +1,215 @@
+#include "mapview.h"
+
+#include <QStyleOptionGraphicsItem>
+
+MapView::MapView(QObject *parent) :
+    QGraphicsScene(parent)
+{
+    hasMap = false;
+    map = nullptr;
+    chunkPixels = 0;
+    chunksWide = chunksHigh = 0;
+
+    chunks.setMaxCost(MAP_CHUNK_CACHE_SIZE);
+
+    connect(&imageWatcher, SIGNAL(finished()), this, SLOT(updateTilesetImage()));
+}
+
+MapView::~MapView()
+{
+    if(hasMap)
+        map->removeObserver(this);
+    chunks.clear();
+}
+
+void MapView::setMap(Map* map)
+{
+    if(hasMap && this->map != map)
+        this->map->removeObserver(this);
+    chunks.clear();
+
+    this->map = map;
+    hasMap = map != nullptr;
+
+    if(!hasMap)
+    {
+        tilesetPyramid = ImagePyramid();
+        tilesetLevels.clear();
+        update();
+        return;
+    }
+
+    map->addObserver(this);
+
+    chunkPixels = MAP_CHUNK_SIZE * map->getTileSize();
+    chunksWide = (map->getWidth() + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    chunksHigh = (map->getHeight() + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+
+    setSceneRect(QRect(0, 0, map->getWidth() * map->getTileSize(), map->getHeight() * map->getTileSize()));
+    updateTilesetImage();
+}
+
+void MapView::updateTilesetImage()
+{
+    chunks.clear();
+    tilesetPyramid = ImagePyramid();
+    tilesetLevels.clear();
+
+    Tileset* tileset = hasMap ? map->getTileSet() : nullptr;
+    if(tileset != nullptr)
+    {
+        if(tileset->isImageReady())
+        {
+            tilesetPyramid = tileset->getPyramid();
+            tilesetLevels.resize(tilesetPyramid.getLevelCount());
+            if(!tilesetLevels.isEmpty())
+                tilesetLevels[0] = tileset->getImage();
+        }
+        else
+            imageWatcher.setFuture(tileset->prefetchImage()); // Called again once decoded
+    }
+
+    update();
+}
+
+void MapView::clearMap()
+{
+    setMap(nullptr);
+}
+
+void MapView::invalidateTile(int x, int y)
+{
+    invalidateRegion(QRect(x, y, 1, 1));
+}
+
+void MapView::tilesChanged(Map* map, const QRect& area)
+{
+    if(map != this->map)
+        return;
+
+    // The map was replaced with one of a different size, the chunk layout has to be rebuilt
+    if(sceneRect() != QRectF(0, 0, map->getWidth() * map->getTileSize(), map->getHeight() * map->getTileSize()))
+        setMap(map);
+    else
+        invalidateRegion(area);
+}
+
+void MapView::invalidateRegion(const QRect& tiles)
+{
+    if(!hasMap || tiles.isEmpty())
+        return;
+
+    int firstX = qMax(0, tiles.left() / MAP_CHUNK_SIZE);
+    int firstY = qMax(0, tiles.top() / MAP_CHUNK_SIZE);
+    int lastX = qMin(chunksWide - 1, tiles.right() / MAP_CHUNK_SIZE);
+    int lastY = qMin(chunksHigh - 1, tiles.bottom() / MAP_CHUNK_SIZE);
+
+    for(int level = 0; level < tilesetLevels.size(); level++)
+    {
+        for(int y = firstY; y <= lastY; y++)
+        {
+            for(int x = firstX; x <= lastX; x++)
+                chunks.remove(chunkKey(x, y, level));
+        }
+    }
+
+    update(QRectF(firstX * chunkPixels, firstY * chunkPixels,
+                  (lastX - firstX + 1) * chunkPixels, (lastY - firstY + 1) * chunkPixels));
+}
+
+void MapView::drawBackground(QPainter *painter, const QRectF &rect)
+{
+    // Nothing is drawn (or cached) until the tileset image is decoded
+    if(!hasMap || tilesetLevels.isEmpty())
+        return;
+
+    QRectF exposed = rect.intersected(sceneRect());
+    if(exposed.isEmpty())
+        return;
+
+    // Only visit the chunks overlapping the exposed area
+    int firstX = qMax(0, static_cast<int>(exposed.left()) / chunkPixels);
+    int firstY = qMax(0, static_cast<int>(exposed.top()) / chunkPixels);
+    int lastX = qMin(chunksWide - 1, static_cast<int>(exposed.right()) / chunkPixels);
+    int lastY = qMin(chunksHigh - 1, static_cast<int>(exposed.bottom()) / chunkPixels);
+
+    // Zoomed out, chunks come from the pyramid level closest to (and no smaller than) the view's scale
+    qreal scale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    int level = scale < 1.0 ? tilesetPyramid.getLevelForScale(scale) : 0;
+
+    for(int y = firstY; y <= lastY; y++)
+    {
+        for(int x = firstX; x <= lastX; x++)
+        {
+            int key = chunkKey(x, y, level);
+            QRectF target(x * chunkPixels, y * chunkPixels, chunkPixels, chunkPixels);
+            QPixmap* chunk = chunks.object(key);
+
+            if(chunk)
+                painter->drawPixmap(target, *chunk, chunk->rect());
+            else
+            {
+                chunk = renderChunk(x, y, level);
+                painter->drawPixmap(target, *chunk, chunk->rect());
+
+                // Draw before caching, the cache takes ownership and may discard the chunk straight away
+                int cost = chunk->width() * chunk->height() * chunk->depth() / (8 * 1024);
+                chunks.insert(key, chunk, qMax(1, cost));
+            }
+        }
+    }
+}
+
+const QPixmap& MapView::getTilesetLevel(int level)
+{
+    if(tilesetLevels[level].isNull())
+        tilesetLevels[level] = QPixmap::fromImage(tilesetPyramid.getLevel(level));
+    return tilesetLevels[level];
+}
+
+QPixmap* MapView::renderChunk(int chunkX, int chunkY, int level)
+{
+    const qreal factor = 1.0 / (1 << level);
+    QPixmap* chunk = new QPixmap(qMax(1, chunkPixels >> level), qMax(1, chunkPixels >> level));
+    chunk->fill(Qt::transparent);
+
+    Tileset* tileset = map->getTileSet();
+    if(tileset == nullptr || level >= tilesetLevels.size())
+        return chunk;
+
+    QMap<int,TilePattern>* patterns = tileset->getPatterns();
+    const int tileSize = map->getTileSize();
+
+    int firstX = chunkX * MAP_CHUNK_SIZE;
+    int firstY = chunkY * MAP_CHUNK_SIZE;
+
+    // Gather every tile drawn over the chunk (including large tiles from neighbouring chunks), then draw them all in a
+    // single call
+    QVector<int> tiles = map->getTilesIn(QRect(chunkX * chunkPixels, chunkY * chunkPixels, chunkPixels, chunkPixels));
+    QVector<QPainter::PixmapFragment> fragments;
+    fragments.reserve(tiles.size());
+
+    for(int index : tiles)
+    {
+        int x = index % map->getWidth();
+        int y = index / map->getWidth();
+
+        QMap<int,TilePattern>::const_iterator iter = patterns->constFind(map->getTile(x, y).getPattern());
+        if(iter == patterns->constEnd())
+            continue;
+
+        const TilePattern& pattern = iter.value();
+
+        // Fragments are positioned by their centre, both it and the source are scaled down to the level
+        QPointF centre((x - firstX) * tileSize + pattern.width / 2.0, (y - firstY) * tileSize + pattern.height / 2.0);
+        QRectF source(pattern.x, pattern.y, pattern.width, pattern.height);
+        fragments.append(QPainter::PixmapFragment::create(centre * factor,
+                                                          QRectF(source.topLeft() * factor, source.size() * factor)));
+    }
+
+    QPainter painter(chunk);
+    painter.drawPixmapFragments(fragments.constData(), fragments.size(), getTilesetLevel(level));
+    painter.end();
+
+    return chunk;
+}
@@ -1,8 +1,11 @@
 #include "gate.h"
 
+#include <QSet>
+
 Gate::Gate()
 {
-
+    type = Door;
+    triggered = false;
 }
 
 Gate::Gate(QString name, Gate::Type type, QStringList keys, bool isTriggered)
@@ -19,9 +22,19 @@ Gate Gate::Parse(Object* object, QList<Key*> keyList)
 
     gate.name =      object->find(ELE_NAME, "");
     gate.type =      static_cast<Gate::Type>(object->find(ELE_GATE_TYPE, "").toInt());
-    gate.keys =       object->find(ELE_KEY_LINKS, "").split(':');
     gate.triggered = (object->find(ELE_TRIGGERED, "false") == "false" ? false : true);
 
+    // Only keep links to keys that exist
+    QSet<QString> keyNames;
+    for(Key* key : keyList)
+        keyNames.insert(key->getName());
+
+    for(const QString& link : object->find(ELE_KEY_LINKS, "").split(':', QString::SkipEmptyParts))
+    {
+        if(keyNames.contains(link) && !gate.keys.contains(link))
+            gate.keys.append(link);
+    }
+
     return gate;
 }
 
@@ -2,7 +2,7 @@
 
 Key::Key()
 {
-
+    type = Switch;
 }
 
 Key::Key(QString name, Key::Type type, QString message)
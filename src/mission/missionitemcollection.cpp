@@ -2,8 +2,7 @@
 
 MissionItemCollection::MissionItemCollection()
 {
-    gates = QMap<QString,Gate>();
-    keyEvents = QMap<QString,Key>();
+    data = nullptr;
 }
 
 MissionItemCollection::~MissionItemCollection()
@@ -17,23 +16,24 @@ MissionItemCollection MissionItemCollection::Parse(Table* data)
     QList<Object*> keyObjects = data->getObjectsOfName(OBJ_KEY_EVENT);
     QList<Object*> gateObjects = data->getObjectsOfName(OBJ_GATE);
 
-    // Clear any existing data
-    collection.gates.clear();
-    collection.keyEvents.clear();
-
     // Parse all objects, and insert them into the collection
     for(Object* obj : keyObjects)
     {
         Key key = Key::Parse(obj);
-        collection.keyEvents.insert(key.getName(), key);
+        if(collection.AddKeyEvent(key.getName(), key))
+            collection.keys[collection.keyIds.value(key.getName())].object = obj;
     }
 
+    // Gates are parsed after all keys, so their key links can be checked
+    QList<Key*> keyList = collection.getKeyEventList();
     for(Object* obj : gateObjects)
     {
-        Gate gate = Gate::Parse(obj, collection.getKeyEventList());
-        collection.gates.insert(gate.getName(), gate);
+        Gate gate = Gate::Parse(obj, keyList);
+        if(collection.AddGate(gate.getName(), gate))
+            collection.gates[collection.gateIds.value(gate.getName())].object = obj;
     }
 
+    collection.data = data;
     return collection;
 }
 
@@ -41,42 +41,76 @@ void MissionItemCollection::Build(Table* table)
 {
     // Clear any existing table data
     table->clear();
+    data = table;
 
     // Build all key events into the table
-    for(QMap<QString,Key>::iterator iter = keyEvents.begin(); iter != keyEvents.end(); iter++)
-        table->addObject(OBJ_KEY_EVENT, iter.value().Build());
+    for(int id = 0; id < keys.size(); id++)
+    {
+        keys[id].object = nullptr;
+        if(keys[id].used)
+            writeKeyObject(id);
+    }
 
     // Build all gates into the table
-    for(QMap<QString,Gate>::iterator iter = gates.begin(); iter != gates.end(); iter++)
-        table->addObject(OBJ_GATE, iter.value().Build());
+    for(int id = 0; id < gates.size(); id++)
+    {
+        gates[id].object = nullptr;
+        if(gates[id].used)
+            writeGateObject(id);
+    }
+}
+
+int MissionItemCollection::getKeyEventId(QString name) const
+{
+    return keyIds.value(name, NO_MISSION_ITEM);
+}
+
+int MissionItemCollection::getGateId(QString name) const
+{
+    return gateIds.value(name, NO_MISSION_ITEM);
 }
 
 Key* MissionItemCollection::getKeyEvent(QString name)
 {
-    QMap<QString,Key>::iterator iter = keyEvents.find(name);
+    return getKeyEvent(getKeyEventId(name));
+}
 
-    if(iter != keyEvents.end())
-        return &iter.value();
+Key* MissionItemCollection::getKeyEvent(int id)
+{
+    if(id >= 0 && id < keys.size() && keys[id].used)
+        return &keys[id].key;
     else
         return nullptr;
 }
 
 Gate* MissionItemCollection::getGate(QString name)
 {
-    QMap<QString,Gate>::iterator iter = gates.find(name);
+    return getGate(getGateId(name));
+}
 
-    if(iter != gates.end())
-        return &iter.value();
+Gate* MissionItemCollection::getGate(int id)
+{
+    if(id >= 0 && id < gates.size() && gates[id].used)
+        return &gates[id].gate;
     else
         return nullptr;
 }
 
+QList<Gate*> MissionItemCollection::getGatesRequiringKey(QString name)
+{
+    QList<Gate*> gateList = QList<Gate*>();
+    for(int id : keyGates.value(name))
+        gateList.append(&gates[id].gate);
+    return gateList;
+}
+
 QList<Gate*> MissionItemCollection::getGateList()
 {
     QList<Gate*> gateList = QList<Gate*>();
-    for(QMap<QString,Gate>::iterator iter = gates.begin(); iter != gates.end(); iter++)
+    for(int id = 0; id < gates.size(); id++)
     {
-        gateList.append(&iter.value());
+        if(gates[id].used)
+            gateList.append(&gates[id].gate);
     }
     return gateList;
 }
@@ -84,9 +118,10 @@ QList<Gate*> MissionItemCollection::getGateList()
 QList<Key*> MissionItemCollection::getKeyEventList()
 {
     QList<Key*> keyList = QList<Key*>();
-    for(QMap<QString,Key>::iterator iter = keyEvents.begin(); iter != keyEvents.end(); iter++)
+    for(int id = 0; id < keys.size(); id++)
     {
-        keyList.append(&iter.value());
+        if(keys[id].used)
+            keyList.append(&keys[id].key);
     }
     return keyList;
 }
@@ -94,59 +129,219 @@ QList<Key*> MissionItemCollection::getKeyEventList()
 QStringList MissionItemCollection::getKeyEventNameList()
 {
     QStringList list = QStringList();
-    for(QMap<QString,Key>::iterator iter = keyEvents.begin(); iter != keyEvents.end(); iter++)
-        list << iter.value().getName();
+    for(int id = 0; id < keys.size(); id++)
+    {
+        if(keys[id].used)
+            list << keys[id].key.getName();
+    }
     return list;
 }
 
 QStringList MissionItemCollection::getGateNameList()
 {
     QStringList list = QStringList();
-    for(QMap<QString,Gate>::iterator iter = gates.begin(); iter != gates.end(); iter++)
-        list << iter.value().getName();
+    for(int id = 0; id < gates.size(); id++)
+    {
+        if(gates[id].used)
+            list << gates[id].gate.getName();
+    }
     return list;
 }
 
 bool MissionItemCollection::AddGate(QString name, Gate gate)
 {
-    if(!gates.contains(name))
+    if(gateIds.contains(name))
+        return false;
+
+    int id;
+    if(freeGateIds.isEmpty())
     {
-        gates.insert(name, gate);
-        return true;
+        id = gates.size();
+        gates.append(GateSlot());
     }
     else
-        return false;
+    {
+        id = freeGateIds.last();
+        freeGateIds.removeLast();
+    }
+
+    gates[id].gate = gate;
+    gates[id].used = true;
+    gateIds.insert(name, id);
+    linkGate(id);
+
+    if(data)
+        writeGateObject(id);
+    return true;
 }
 
 bool MissionItemCollection::AddKeyEvent(QString name, Key key)
 {
-    if(!keyEvents.contains(name))
+    if(keyIds.contains(name))
+        return false;
+
+    int id;
+    if(freeKeyIds.isEmpty())
     {
-        keyEvents.insert(name, key);
-        return true;
+        id = keys.size();
+        keys.append(KeySlot());
     }
     else
-        return false;
+    {
+        id = freeKeyIds.last();
+        freeKeyIds.removeLast();
+    }
+
+    keys[id].key = key;
+    keys[id].used = true;
+    keyIds.insert(name, id);
+
+    if(data)
+        writeKeyObject(id);
+    return true;
 }
 
 bool MissionItemCollection::RemoveKeyEvent(QString name)
 {
-    if(keyEvents.contains(name))
+    int id = keyIds.value(name, NO_MISSION_ITEM);
+    if(id == NO_MISSION_ITEM)
+        return false;
+
+    // Gates keep their link to the key by name, so it is restored if the key is added again
+    if(data && keys[id].object)
+        data->removeObject(OBJ_KEY_EVENT, keys[id].object);
+
+    keys[id] = KeySlot();
+    keyIds.remove(name);
+    freeKeyIds.append(id);
+    return true;
+}
+
+bool MissionItemCollection::RemoveGate(QString name)
+{
+    int id = gateIds.value(name, NO_MISSION_ITEM);
+    if(id == NO_MISSION_ITEM)
+        return false;
+
+    unlinkGate(id);
+    if(data && gates[id].object)
+        data->removeObject(OBJ_GATE, gates[id].object);
+
+    gates[id] = GateSlot();
+    gateIds.remove(name);
+    freeGateIds.append(id);
+    return true;
+}
+
+bool MissionItemCollection::ReplaceKeyEvent(QString name, Key key)
+{
+    int id = keyIds.value(name, NO_MISSION_ITEM);
+    if(id == NO_MISSION_ITEM)
+        return false;
+
+    QString newName = key.getName();
+    if(newName != name)
     {
-        keyEvents.remove(name);
-        return true;
+        if(keyIds.contains(newName))
+            return false;
+
+        keyIds.remove(name);
+        keyIds.insert(newName, id);
+
+        // Point every gate that needs the key at its new name
+        QVector<int> dependents = keyGates.take(name);
+        for(int gateId : dependents)
+        {
+            Gate& gate = gates[gateId].gate;
+            QStringList gateKeys = gate.getKeys();
+            for(QString& gateKey : gateKeys)
+            {
+                if(gateKey == name)
+                    gateKey = newName;
+            }
+            gate.setKeys(gateKeys);
+
+            if(data)
+                writeGateObject(gateId);
+        }
+        keyGates[newName] += dependents;
     }
-    else
+
+    keys[id].key = key;
+    if(data)
+        writeKeyObject(id);
+    return true;
+}
+
+bool MissionItemCollection::ReplaceGate(QString name, Gate gate)
+{
+    int id = gateIds.value(name, NO_MISSION_ITEM);
+    if(id == NO_MISSION_ITEM)
         return false;
+
+    QString newName = gate.getName();
+    if(newName != name)
+    {
+        if(gateIds.contains(newName))
+            return false;
+
+        gateIds.remove(name);
+        gateIds.insert(newName, id);
+    }
+
+    unlinkGate(id);
+    gates[id].gate = gate;
+    linkGate(id);
+
+    if(data)
+        writeGateObject(id);
+    return true;
 }
 
-bool MissionItemCollection::RemoveGate(QString name)
+void MissionItemCollection::linkGate(int id)
 {
-    if(gates.contains(name))
+    for(const QString& key : gates[id].gate.getKeys())
     {
-        gates.remove(name);
-        return true;
+        QVector<int>& dependents = keyGates[key];
+        if(!dependents.contains(id))
+            dependents.append(id);
     }
+}
+
+void MissionItemCollection::unlinkGate(int id)
+{
+    for(const QString& key : gates[id].gate.getKeys())
+    {
+        QHash<QString,QVector<int>>::iterator iter = keyGates.find(key);
+        if(iter == keyGates.end())
+            continue;
+
+        iter.value().removeAll(id);
+        if(iter.value().isEmpty())
+            keyGates.erase(iter);
+    }
+}
+
+void MissionItemCollection::writeKeyObject(int id)
+{
+    KeySlot& slot = keys[id];
+    if(slot.object == nullptr)
+        slot.object = data->addObject(OBJ_KEY_EVENT, slot.key.Build());
     else
-        return false;
+    {
+        slot.object->data = slot.key.Build().data;
+        data->markDirty(slot.object);
+    }
+}
+
+void MissionItemCollection::writeGateObject(int id)
+{
+    GateSlot& slot = gates[id];
+    if(slot.object == nullptr)
+        slot.object = data->addObject(OBJ_GATE, slot.gate.Build());
+    else
+    {
+        slot.object->data = slot.gate.Build().data;
+        data->markDirty(slot.object);
+    }
 }
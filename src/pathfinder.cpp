@@ -0,0 +1,384 @@
+#include "pathfinder.h"
+#include "profiler.h"
+
+#include <QtConcurrent>
+#include <QThreadStorage>
+#include <QHash>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+const qreal SQRT2 = 1.41421356237309504880;
+
+/*!
+ * \brief Entry in the open list. Ordered so that the std heap functions produce a min-heap on f.
+ */
+struct OpenNode
+{
+    OpenNode(qreal f, int index) : f(f), index(index) { }
+
+    qreal f;
+    int index;
+
+    bool operator<(const OpenNode& other) const { return f > other.f; }
+};
+
+/*!
+ * \brief Per-thread search state. Buffers grow to the largest grid searched on the thread and are reused between
+ *        queries. Generation stamps mark which entries belong to the current search, so nothing is cleared per query.
+ */
+struct SearchScratch
+{
+    SearchScratch() : generation(0) { }
+
+    void prepare(int cellCount)
+    {
+        if(static_cast<int>(seen.size()) < cellCount)
+        {
+            seen.resize(cellCount, 0);
+            closed.resize(cellCount, 0);
+            g.resize(cellCount);
+            parent.resize(cellCount);
+        }
+
+        generation++;
+        if(generation == 0) // Stamps wrapped around, old entries could look current
+        {
+            std::fill(seen.begin(), seen.end(), 0);
+            std::fill(closed.begin(), closed.end(), 0);
+            generation = 1;
+        }
+
+        open.clear();
+    }
+
+    inline bool isSeen(int index) const   { return seen[index] == generation; }
+    inline bool isClosed(int index) const { return closed[index] == generation; }
+    inline void close(int index)          { closed[index] = generation; }
+
+    inline void visit(int index, qreal cost, int from)
+    {
+        seen[index] = generation;
+        g[index] = cost;
+        parent[index] = from;
+    }
+
+    inline void push(int index, qreal f)
+    {
+        open.push_back(OpenNode(f, index));
+        std::push_heap(open.begin(), open.end());
+    }
+
+    inline OpenNode pop()
+    {
+        std::pop_heap(open.begin(), open.end());
+        OpenNode node = open.back();
+        open.pop_back();
+        return node;
+    }
+
+    quint32 generation;
+    std::vector<quint32> seen;   /*!< Generation in which g and parent were last written. */
+    std::vector<quint32> closed; /*!< Generation in which the cell was expanded. */
+    std::vector<qreal> g;
+    std::vector<int> parent;
+    std::vector<OpenNode> open;  /*!< Binary heap of open cells. Stale duplicates are skipped when popped. */
+};
+
+QThreadStorage<SearchScratch*> scratchStorage;
+
+SearchScratch& localScratch()
+{
+    if(!scratchStorage.hasLocalData())
+        scratchStorage.setLocalData(new SearchScratch());
+    return *scratchStorage.localData();
+}
+
+inline int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+inline qreal octile(int x0, int y0, int x1, int y1)
+{
+    int dx = qAbs(x1 - x0);
+    int dy = qAbs(y1 - y0);
+    return qMax(dx, dy) + (SQRT2 - 1.0) * qMin(dx, dy);
+}
+
+/*!
+ * \brief Moves from (x, y) in direction (dx, dy) until a jump point, the goal or an obstacle is reached.
+ * \return Index of the jump point, or -1 if the direction leads nowhere.
+ */
+int jump(const PathGrid& grid, int x, int y, int dx, int dy, int goal)
+{
+    const int width = grid.getWidth();
+
+    for(;;)
+    {
+        if(!grid.isWalkable(x, y))
+            return -1;
+
+        int index = y * width + x;
+        if(index == goal)
+            return index;
+
+        if(dx != 0 && dy != 0)
+        {
+            // A diagonal run stops wherever a straight run from it would find something
+            if(jump(grid, x + dx, y, dx, 0, goal) != -1 || jump(grid, x, y + dy, 0, dy, goal) != -1)
+                return index;
+        }
+        else if(dx != 0)
+        {
+            if((grid.isWalkable(x, y - 1) && !grid.isWalkable(x - dx, y - 1)) ||
+               (grid.isWalkable(x, y + 1) && !grid.isWalkable(x - dx, y + 1)))
+                return index;
+        }
+        else
+        {
+            if((grid.isWalkable(x - 1, y) && !grid.isWalkable(x - 1, y - dy)) ||
+               (grid.isWalkable(x + 1, y) && !grid.isWalkable(x + 1, y - dy)))
+                return index;
+        }
+
+        // Diagonal steps may not cut corners
+        if(!grid.isWalkable(x + dx, y) || !grid.isWalkable(x, y + dy))
+            return -1;
+
+        x += dx;
+        y += dy;
+    }
+}
+
+/*!
+ * \brief Collects the pruned set of directions to search from a cell, given the cell it was reached from.
+ * \return The number of directions written to dirs.
+ */
+int neighbourDirections(const PathGrid& grid, int x, int y, int parent, QPoint* dirs)
+{
+    int count = 0;
+
+    if(parent == -1) // Start cell, search everything that is reachable
+    {
+        for(int dy = -1; dy <= 1; dy++)
+        {
+            for(int dx = -1; dx <= 1; dx++)
+            {
+                if(dx == 0 && dy == 0)
+                    continue;
+                if(!grid.isWalkable(x + dx, y + dy))
+                    continue;
+                if(dx != 0 && dy != 0 && (!grid.isWalkable(x + dx, y) || !grid.isWalkable(x, y + dy)))
+                    continue;
+                dirs[count++] = QPoint(dx, dy);
+            }
+        }
+        return count;
+    }
+
+    const int width = grid.getWidth();
+    int dx = sign(x - parent % width);
+    int dy = sign(y - parent / width);
+
+    if(dx != 0 && dy != 0)
+    {
+        bool vertical = grid.isWalkable(x, y + dy);
+        bool horizontal = grid.isWalkable(x + dx, y);
+
+        if(vertical)
+            dirs[count++] = QPoint(0, dy);
+        if(horizontal)
+            dirs[count++] = QPoint(dx, 0);
+        if(vertical && horizontal)
+            dirs[count++] = QPoint(dx, dy);
+    }
+    else if(dx != 0)
+    {
+        bool next = grid.isWalkable(x + dx, y);
+        bool below = grid.isWalkable(x, y + 1);
+        bool above = grid.isWalkable(x, y - 1);
+
+        if(next)
+        {
+            dirs[count++] = QPoint(dx, 0);
+            if(below)
+                dirs[count++] = QPoint(dx, 1);
+            if(above)
+                dirs[count++] = QPoint(dx, -1);
+        }
+        if(below)
+            dirs[count++] = QPoint(0, 1);
+        if(above)
+            dirs[count++] = QPoint(0, -1);
+    }
+    else
+    {
+        bool next = grid.isWalkable(x, y + dy);
+        bool right = grid.isWalkable(x + 1, y);
+        bool left = grid.isWalkable(x - 1, y);
+
+        if(next)
+        {
+            dirs[count++] = QPoint(0, dy);
+            if(right)
+                dirs[count++] = QPoint(1, dy);
+            if(left)
+                dirs[count++] = QPoint(-1, dy);
+        }
+        if(right)
+            dirs[count++] = QPoint(1, 0);
+        if(left)
+            dirs[count++] = QPoint(-1, 0);
+    }
+
+    return count;
+}
+
+} // namespace
+
+PathGrid::PathGrid() :
+    width(0), height(0)
+{
+
+}
+
+PathGrid::PathGrid(int width, int height) :
+    width(width), height(height), cells(width * height, 0)
+{
+
+}
+
+PathGrid PathGrid::fromMap(const Map* map)
+{
+    PathGrid grid(map->getWidth(), map->getHeight());
+
+    for(int y = 0; y < grid.height; y++)
+    {
+        for(int x = 0; x < grid.width; x++)
+            grid.setWalkable(x, y, map->isTraversable(x, y));
+    }
+
+    return grid;
+}
+
+PathResult Pathfinder::findPath(const PathGrid& grid, QPoint start, QPoint goal)
+{
+    PathResult result;
+
+    if(!grid.isWalkable(start.x(), start.y()) || !grid.isWalkable(goal.x(), goal.y()))
+        return result;
+
+    const int width = grid.getWidth();
+    const int startIndex = start.y() * width + start.x();
+    const int goalIndex = goal.y() * width + goal.x();
+
+    SearchScratch& scratch = localScratch();
+    scratch.prepare(width * grid.getHeight());
+
+    scratch.visit(startIndex, 0.0, -1);
+    scratch.push(startIndex, octile(start.x(), start.y(), goal.x(), goal.y()));
+
+    QPoint dirs[8];
+    while(!scratch.open.empty())
+    {
+        OpenNode node = scratch.pop();
+        if(scratch.isClosed(node.index))
+            continue; // Stale duplicate of a cell that was already expanded
+        scratch.close(node.index);
+
+        if(node.index == goalIndex)
+        {
+            // Walk back through the parents to build the list of jump points
+            for(int index = goalIndex; index != -1; index = scratch.parent[index])
+                result.points.prepend(QPoint(index % width, index / width));
+
+            result.found = true;
+            result.length = scratch.g[goalIndex];
+            return result;
+        }
+
+        int x = node.index % width;
+        int y = node.index / width;
+
+        int count = neighbourDirections(grid, x, y, scratch.parent[node.index], dirs);
+        for(int i = 0; i < count; i++)
+        {
+            int jumpIndex = jump(grid, x + dirs[i].x(), y + dirs[i].y(), dirs[i].x(), dirs[i].y(), goalIndex);
+            if(jumpIndex == -1 || scratch.isClosed(jumpIndex))
+                continue;
+
+            int jumpX = jumpIndex % width;
+            int jumpY = jumpIndex / width;
+            qreal cost = scratch.g[node.index] + octile(x, y, jumpX, jumpY);
+
+            if(!scratch.isSeen(jumpIndex) || cost < scratch.g[jumpIndex])
+            {
+                scratch.visit(jumpIndex, cost, node.index);
+                scratch.push(jumpIndex, cost + octile(jumpX, jumpY, goal.x(), goal.y()));
+            }
+        }
+    }
+
+    return result; // Goal was not reachable
+}
+
+QVector<PathResult> Pathfinder::findPaths(const QList<PathQuery>& queries)
+{
+    PROFILE_SCOPE("Pathfinder::findPaths");
+    PROFILE_COUNTER("Path queries", queries.size());
+
+    // Group the queries by map, so each map's grid is only built once. Queries without a map keep an empty result.
+    QHash<Map*,QList<int>> groups;
+    for(int i = 0; i < queries.size(); i++)
+    {
+        if(queries[i].map != nullptr)
+            groups[queries[i].map].append(i);
+    }
+
+    QList<QList<int>> jobs = groups.values();
+    QVector<PathResult> results(queries.size());
+    PathResult* out = results.data();
+
+    QtConcurrent::blockingMap(jobs, [&queries, out](const QList<int>& job)
+    {
+        PROFILE_SCOPE("Pathfinder::findPaths job");
+        PathGrid grid = PathGrid::fromMap(queries[job.first()].map);
+        for(int i : job)
+            out[i] = findPath(grid, queries[i].start, queries[i].goal);
+    });
+
+    return results;
+}
+
+QVector<qreal> Pathfinder::findDistances(Map* map, const QVector<QPoint>& points)
+{
+    PROFILE_SCOPE("Pathfinder::findDistances");
+
+    const int count = points.size();
+    QVector<qreal> distances(count * count, 0.0);
+    qreal* out = distances.data();
+
+    PathGrid grid = PathGrid::fromMap(map);
+
+    QVector<int> rows;
+    for(int i = 0; i < count; i++)
+        rows.append(i);
+
+    // Each row searches from one point to every later point, filling both halves of the matrix
+    QtConcurrent::blockingMap(rows, [&grid, &points, count, out](int row)
+    {
+        PROFILE_SCOPE("Pathfinder::findDistances row");
+        for(int column = row + 1; column < count; column++)
+        {
+            PathResult path = findPath(grid, points[row], points[column]);
+            qreal distance = path.found ? path.length : -1.0;
+            out[row * count + column] = distance;
+            out[column * count + row] = distance;
+        }
+    });
+
+    return distances;
+}
@@ -3,19 +3,21 @@
 Preferences::Preferences()
 {
     data = new Table(DAT_PREFERENCES);
-    if(data->isEmpty())
+
+    // Changes go through the table, so it knows they have to be saved
+    prefs = data->getObject(OBJ_PREFERENCES);
+    if(prefs == nullptr)
     {
         Object obj = Object();
         obj.insert(ELE_SOLARUS_PATH, "DEFAULT");
-        data->addObject(OBJ_PREFERENCES, obj);
+        prefs = data->addObject(OBJ_PREFERENCES, obj);
     }
-    else if(data->getObject(OBJ_PREFERENCES)->data.isEmpty())
+    else if(!prefs->data.contains(ELE_SOLARUS_PATH))
     {
-        data->getObject(OBJ_PREFERENCES)->data.insert(ELE_SOLARUS_PATH, "DEFAULT");
+        prefs->insert(ELE_SOLARUS_PATH, "DEFAULT");
+        data->markDirty(prefs);
     }
 
-    prefs = data->getObject(OBJ_PREFERENCES);
-
     solarusPath = prefs->find(ELE_SOLARUS_PATH, "DEFAULT");
 
     data->saveToDisk();
@@ -25,3 +27,9 @@ Preferences::~Preferences()
 {
     delete data;
 }
+
+void Preferences::setSolarusPath(QString solarusPath)
+{
+    this->solarusPath = solarusPath;
+    data->setElementValue(OBJ_PREFERENCES, ELE_SOLARUS_PATH, solarusPath);
+}
@@ -0,0 +1,157 @@
+#include "profiler.h"
+
+#ifdef PLD_PROFILE
+
+#include <QThread>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+// Plain integers, so they need no construction and can be used before main and from any thread
+thread_local qint64 threadAllocations = 0;
+thread_local qint64 threadBytes = 0;
+
+QElapsedTimer startClock()
+{
+    QElapsedTimer clock;
+    clock.start();
+    return clock;
+}
+
+} // namespace
+
+/*
+ * Allocations are counted by replacing the global operators. The array forms call these, so they are counted too.
+ */
+void* operator new(std::size_t size)
+{
+    threadAllocations++;
+    threadBytes += size;
+
+    void* memory = std::malloc(size ? size : 1);
+    if(memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+QMutex Profiler::mutex;
+QVector<ProfileEvent> Profiler::events;
+QElapsedTimer Profiler::clock = startClock();
+
+qint64 Profiler::now()
+{
+    return clock.nsecsElapsed() / 1000;
+}
+
+void Profiler::record(const ProfileEvent& event)
+{
+    QMutexLocker lock(&mutex);
+    events.append(event);
+}
+
+void Profiler::counter(const char* name, qint64 value)
+{
+    ProfileEvent event;
+    event.name = name;
+    event.phase = 'C';
+    event.thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    event.start = now();
+    event.duration = 0;
+    event.value = value;
+    event.bytes = 0;
+    record(event);
+}
+
+void Profiler::throughput(const char* name, qint64 bytes, qint64 start)
+{
+    qint64 elapsed = qMax<qint64>(1, now() - start);
+    counter(name, bytes * 1000000 / 1024 / elapsed);
+}
+
+qint64 Profiler::allocationCount()
+{
+    return threadAllocations;
+}
+
+qint64 Profiler::allocatedBytes()
+{
+    return threadBytes;
+}
+
+bool Profiler::writeTrace(QString filePath)
+{
+    QVector<ProfileEvent> recorded;
+    {
+        QMutexLocker lock(&mutex);
+        recorded = events;
+    }
+
+    QJsonArray traceEvents;
+    for(const ProfileEvent& event : recorded)
+    {
+        QJsonObject object;
+        object.insert("name", QString::fromLatin1(event.name));
+        object.insert("ph", QString(QChar(event.phase)));
+        object.insert("pid", 1);
+        object.insert("tid", static_cast<qint64>(event.thread));
+        object.insert("ts", event.start);
+
+        QJsonObject args;
+        if(event.phase == 'X')
+        {
+            object.insert("dur", event.duration);
+            args.insert("allocations", event.value);
+            args.insert("bytes", event.bytes);
+        }
+        else
+            args.insert("value", event.value);
+
+        object.insert("args", args);
+        traceEvents.append(object);
+    }
+
+    QJsonObject trace;
+    trace.insert("traceEvents", traceEvents);
+    trace.insert("displayTimeUnit", QString("ms"));
+
+    QFile file(filePath);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+
+    file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+    return true;
+}
+
+ProfileScope::ProfileScope(const char* name)
+{
+    this->name = name;
+    allocations = Profiler::allocationCount();
+    bytes = Profiler::allocatedBytes();
+    start = Profiler::now();
+}
+
+ProfileScope::~ProfileScope()
+{
+    ProfileEvent event;
+    event.name = name;
+    event.phase = 'X';
+    event.thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    event.start = start;
+    event.duration = Profiler::now() - start;
+    event.value = Profiler::allocationCount() - allocations;
+    event.bytes = Profiler::allocatedBytes() - bytes;
+    Profiler::record(event);
+}
+
+#endif // PLD_PROFILE
@@ -1,67 +1,218 @@
 #include "quest.h"
 
+#include <QtConcurrent>
+
+#include "profiler.h"
+#include "thumbnailcache.h"
+
+namespace
+{
+
+typedef QHash<int,int> PatternHistogram; /*!< Number of tiles using each pattern, by pattern ID. */
+
+PatternHistogram countPatterns(Map* map)
+{
+    PatternHistogram histogram;
+    for(int y = 0; y < map->getHeight(); y++)
+    {
+        for(int x = 0; x < map->getWidth(); x++)
+            histogram[map->getTile(x, y).getPattern()]++;
+    }
+    return histogram;
+}
+
+void mergeHistogram(PatternHistogram& total, const PatternHistogram& partial)
+{
+    for(PatternHistogram::const_iterator iter = partial.constBegin(); iter != partial.constEnd(); iter++)
+        total[iter.key()] += iter.value();
+}
+
+} // namespace
+
+QuestFileFilter::QuestFileFilter(QFileSystemModel* model, QStringList nameFilters, QString rootPath)
+{
+    setSourceModel(model);
+    this->rootPath = rootPath;
+
+    for(const QString& filter : nameFilters)
+        filters.append(QRegExp(filter, Qt::CaseInsensitive, QRegExp::Wildcard));
+}
+
+bool QuestFileFilter::filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const
+{
+    QFileSystemModel* model = static_cast<QFileSystemModel*>(sourceModel());
+    QModelIndex index = model->index(sourceRow, 0, sourceParent);
+
+    // Keep the path down to the root visible, so the root itself can be reached
+    if(!rootPath.isEmpty())
+    {
+        QString path = model->filePath(index);
+        if(!path.startsWith(rootPath) && !rootPath.startsWith(path))
+            return false;
+    }
+
+    if(model->isDir(index))
+        return true;
+
+    QString fileName = model->fileName(index);
+    for(const QRegExp& filter : filters)
+    {
+        if(filter.exactMatch(fileName))
+            return true;
+    }
+
+    return false;
+}
+
 Quest::Quest()
 {
+    hasRootDir = false;
     fsModel = nullptr;
     scriptModel = nullptr;
     mapModel = nullptr;
 }
 
-Quest::Quest(QString dirPath)
+Quest::Quest(QString dirPath) : Quest()
 {
-    // Set up file system models
+    // File system models are only created once they are needed
     rootDir = QDir(dirPath);
-    fsModel = new QFileSystemModel();
-    scriptModel = new QFileSystemModel();
-    mapModel = new QFileSystemModel();
+    hasRootDir = true;
+}
 
-    maps = QMap<QString,Map>();
-    tileSets = QMap<QString,Tileset>();
+Quest::Quest(Quest&& param) : Quest()
+{
+    take(param);
+}
 
-    fsModel->setRootPath(rootDir.absolutePath());
-    scriptModel->setRootPath(rootDir.absolutePath());
-    mapModel->setRootPath(rootDir.absolutePath() + QDir::separator() + "maps" + QDir::separator());
+Quest& Quest::operator=(Quest&& param)
+{
+    if(this != &param)
+    {
+        clear();
+        take(param);
+    }
+    return *this;
+}
 
-    initFilters();
+void Quest::take(Quest& param)
+{
+    rootDir = param.rootDir;
+    hasRootDir = param.hasRootDir;
+    fsModel = param.fsModel;
+    scriptModel = param.scriptModel;
+    mapModel = param.mapModel;
+
+    // Containers are swapped rather than copied, so pointers to their contents (such as the tileset of each map) stay valid
+    data.swap(param.data);
+    maps.swap(param.maps);
+    tileSets.swap(param.tileSets);
+    mission = param.mission;
+    index = param.index;
+
+    param.rootDir = QDir();
+    param.hasRootDir = false;
+    param.fsModel = nullptr;
+    param.scriptModel = param.mapModel = nullptr;
+    param.data.clear();
+    param.maps.clear();
+    param.tileSets.clear();
+    param.mission = Mission();
+    param.index.clear();
 }
 
 bool Quest::Init()
 {
+    PROFILE_SCOPE("Quest::Init");
+
+    if(!initHeader())
+        return false;
+
+    for(const QString& filePath : getContentPaths())
+        addLoadedData(filePath, QSharedPointer<Table>(new Table(getDataFilePath(filePath))));
+
+    return true;
+}
+
+bool Quest::initHeader()
+{
+    PROFILE_SCOPE("Quest::initHeader");
+
     Table* quest = getData(DAT_QUEST);
 
-    if(quest == nullptr)
+    if(!quest->existsOnDisk())
         return false;
-    else
+
+    getData(DAT_DATABASE);
+
+    // Initialize the mission
+    Table* missionItems = getData(DAT_MISSION_ITEMS);
+    mission.init(missionItems);
+
+    return true;
+}
+
+QStringList Quest::getContentPaths() const
+{
+    QStringList paths;
+    QStringList filters;
+    filters << "*.dat";
+
+    // Tilesets come first, so maps can be linked to them as they are added
+    QDir tileSetDir = QDir(rootDir.absolutePath() + QDir::separator() + "tilesets" + QDir::separator());
+    tileSetDir.setNameFilters(filters);
+    for(QFileInfo f : tileSetDir.entryInfoList())
+        paths.append(QString("tilesets") + QDir::separator() + f.baseName());
+
+    QDir mapDir = QDir(rootDir.absolutePath() + QDir::separator() + "maps" + QDir::separator());
+    mapDir.setNameFilters(filters);
+    for(QFileInfo f : mapDir.entryInfoList())
+        paths.append(QString("maps") + QDir::separator() + f.baseName());
+
+    return paths;
+}
+
+QString Quest::getDataFilePath(QString filePath) const
+{
+    return rootDir.absolutePath() + QDir::separator() + filePath + DAT_EXT;
+}
+
+void Quest::addLoadedData(QString filePath, QSharedPointer<Table> loaded, const QImage& thumbnail)
+{
+    PROFILE_SCOPE("Quest::addLoadedData");
+
+    data.insert(filePath, loaded);
+    Table* table = loaded.data();
+
+    QString folder = filePath.section(QDir::separator(), 0, 0);
+    QString name = filePath.section(QDir::separator(), 1);
+
+    if(folder == "tilesets")
     {
-        // Load all existing tilesets
-        QDir tileSetDir = QDir(rootDir.absolutePath() + QDir::separator() + "tilesets" + QDir::separator());
-        QStringList filters;
-        filters << "*.dat";
-        tileSetDir.setNameFilters(filters);
-        QFileInfoList tilesetData = tileSetDir.entryInfoList();
-
-        for(QFileInfo f : tilesetData)
+        Tileset tileset = Tileset::parse(name, table);
+        tileset.setThumbnail(thumbnail);
+        QMap<QString,Tileset>::iterator inserted = tileSets.insert(name, tileset);
+
+        // Link any maps that were added before their tileset
+        for(QMap<QString,Map>::iterator map = maps.begin(); map != maps.end(); map++)
         {
-            Table* data = getData(QString("tilesets") + QDir::separator() + f.baseName());
-            tileSets.insert(f.baseName(), Tileset::parse(f.baseName(), data));
+            if(map.value().getTileSet() == nullptr &&
+               getData(QString("maps") + QDir::separator() + map.key())->getElementValue(OBJ_PROPERTIES, ELE_TILESET) == name)
+                linkMap(map.key(), map.value(), &inserted.value());
         }
-
-        // Load all existing maps
-        QDir mapDir = QDir(rootDir.absolutePath() + QDir::separator() + "maps" + QDir::separator());
-        mapDir.setNameFilters(filters);
-        QFileInfoList mapData = mapDir.entryInfoList();
-
-        for(QFileInfo f : mapData)
+    }
+    else if(folder == "maps")
+    {
+        // Link the map to the tileset it uses, if that tileset is part of this quest. Tiles are placed on the tileset's
+        // grid, or re-placed once the tileset is added.
+        QMap<QString,Tileset>::iterator tileset = tileSets.find(table->getElementValue(OBJ_PROPERTIES, ELE_TILESET));
+        if(tileset != tileSets.end())
         {
-            Table* data = getData(QString("maps") + QDir::separator() + f.baseName());
-            maps.insert(f.baseName(), Map::parse(f.baseName(), data));
+            Map map = Map::parse(name, table, tileset.value().getTileSize());
+            map.setTileSet(&tileset.value());
+            maps.insert(name, map);
         }
-
-        // Initialize the mission
-        Table* missionItems = getData(DAT_MISSION_ITEMS);
-        mission.init(missionItems);
-
-        return true;
+        else
+            maps.insert(name, Map::parse(name, table));
     }
 }
 
@@ -72,16 +223,25 @@ Quest::~Quest()
 
 QFileSystemModel* Quest::getFSModel()
 {
+    if(fsModel == nullptr && hasRootDir)
+    {
+        fsModel = new QFileSystemModel();
+        fsModel->setRootPath(rootDir.absolutePath());
+    }
     return fsModel;
 }
 
-QFileSystemModel* Quest::getScriptModel()
+QSortFilterProxyModel* Quest::getScriptModel()
 {
+    if(scriptModel == nullptr && getFSModel() != nullptr)
+        scriptModel = new QuestFileFilter(fsModel, QStringList() << "*.lua");
     return scriptModel;
 }
 
-QFileSystemModel* Quest::getMapModel()
+QSortFilterProxyModel* Quest::getMapModel()
 {
+    if(mapModel == nullptr && getFSModel() != nullptr)
+        mapModel = new QuestFileFilter(fsModel, QStringList() << "*.dat", rootDir.absolutePath() + QDir::separator() + "maps");
     return mapModel;
 }
 
@@ -116,87 +276,107 @@ void Quest::saveData() const
     }
 }
 
-Quest& Quest::operator=(const Quest& param)
+Table* Quest::getData(QString filePath)
 {
-    if(this == &param)
-        return *this;
+    QString absolutePath = getDataFilePath(filePath);
+
+    auto iter = data.find(filePath);
+
+    if(iter != data.end()) // If data already loaded, return the table stored in memory
+        return iter.value().data();
     else
     {
-        cpy(param);
-        return *this;
+        Table* table = new Table(absolutePath); // Parse existing data, or create new table
+        data.insert(filePath, QSharedPointer<Table>(table)); // Insert into map of loaded data
+        return table;
     }
 }
 
-Quest::Quest(const Quest& param)
+QStringList Quest::getDataPaths() const
 {
-    cpy(param);
+    return data.keys();
 }
 
-void Quest::cpy(const Quest& param)
+bool Quest::reloadData(QString filePath, Table* source)
 {
-    if(param.fsModel)
-    {
-        rootDir = param.rootDir;
-
-        fsModel = new QFileSystemModel();
-        fsModel->setRootPath(rootDir.absolutePath());
+    QMap<QString,QSharedPointer<Table>>::iterator iter = data.find(filePath);
+    if(iter == data.end())
+        return false;
 
-        scriptModel = new QFileSystemModel();
-        scriptModel->setRootPath(rootDir.absolutePath());
+    Table* table = iter.value().data();
+    table->replaceContents(source);
 
-        mapModel = new QFileSystemModel();
-        mapModel->setRootPath(rootDir.absolutePath() + QDir::separator() + "maps" + QDir::separator());
+    QString folder = filePath.section(QDir::separator(), 0, 0);
+    QString name = filePath.section(QDir::separator(), 1);
 
-        initFilters();
+    if(filePath == DAT_MISSION_ITEMS)
+        mission.init(table);
+    else if(folder == "tilesets")
+    {
+        QMap<QString,Tileset>::iterator tileset = tileSets.find(name);
+        if(tileset != tileSets.end())
+        {
+            // Only the table changed, the image and its thumbnail are kept
+            Tileset parsed = Tileset::parse(name, table);
+            parsed.setThumbnail(tileset.value().getThumbnail());
+            tileset.value() = parsed;
+
+            // Pattern sizes may have changed, so maps using the tileset re-index their large tiles
+            for(QMap<QString,Map>::iterator map = maps.begin(); map != maps.end(); map++)
+            {
+                if(map.value().getTileSet() == &tileset.value())
+                    linkMap(map.key(), map.value(), &tileset.value());
+            }
+        }
     }
-    else
-        fsModel = nullptr;
-}
-
-void Quest::initFilters()
-{
-    scriptModel->setNameFilters(QStringList()<<"*.lua");
-    mapModel->setNameFilters(QStringList()<<"*.dat");
-
-    scriptModel->setNameFilterDisables(false);
-    mapModel->setNameFilterDisables(false);
-}
-
-Table* Quest::getData(QString filePath)
-{
-    QString absolutePath = getRootDir().absolutePath() + QDir::separator() + filePath + DAT_EXT;
-
-    auto iter = data.find(filePath);
-
-    if(iter != data.end()) // If data already loaded, return the table stored in memory
-        return iter.value().data();
-    else
+    else if(folder == "maps")
     {
-        Table* table = new Table(absolutePath); // Parse existing data, or create new table
-        data.insert(filePath, QSharedPointer<Table>(table)); // Insert into map of loaded data
-        return table;
+        QMap<QString,Map>::iterator map = maps.find(name);
+        if(map != maps.end())
+        {
+            Map parsed;
+            QMap<QString,Tileset>::iterator tileset = tileSets.find(table->getElementValue(OBJ_PROPERTIES, ELE_TILESET));
+            if(tileset != tileSets.end())
+            {
+                parsed = Map::parse(name, table, tileset.value().getTileSize());
+                parsed.setTileSet(&tileset.value());
+            }
+            else
+                parsed = Map::parse(name, table);
+
+            map.value().replaceContents(parsed);
+        }
     }
+
+    return true;
 }
 
 void Quest::clear()
 {
     data.clear();
+    maps.clear();
+    tileSets.clear();
+    mission = Mission();
+    index.clear();
     rootDir = "";
+    hasRootDir = false;
 
-    if(fsModel)
-        delete fsModel;
+    // Filters go first, they refer to the main model
     if(scriptModel)
         delete scriptModel;
     if(mapModel)
         delete mapModel;
+    if(fsModel)
+        delete fsModel;
 
-    fsModel = scriptModel = mapModel = nullptr;
-
+    fsModel = nullptr;
+    scriptModel = mapModel = nullptr;
 }
 
 Map* Quest::getMap(QString name)
 {
-    return &(*maps.find(name));
+    QMap<QString,Map>::iterator iter = maps.find(name);
+    return iter == maps.end() ? nullptr : &(*iter);
 }
 
 QMap<QString,Map>* Quest::getMaps()
@@ -216,7 +396,8 @@ QList<Map*> Quest::getMapList()
 
 Tileset* Quest::getTileset(QString name)
 {
-    return &(*tileSets.find(name));
+    QMap<QString,Tileset>::iterator iter = tileSets.find(name);
+    return iter == tileSets.end() ? nullptr : &(*iter);
 }
 
 QMap<QString,Tileset>* Quest::getTilesets()
@@ -259,17 +440,249 @@ bool Quest::removeTileset(QString name)
     }
 }
 
+bool Quest::mergeTilesets(QStringList names, QString newName)
+{
+    PROFILE_SCOPE("Quest::mergeTilesets");
+
+    if(names.isEmpty() || tileSets.contains(newName))
+        return false;
+
+    QList<Tileset*> sources;
+    for(const QString& name : names)
+    {
+        QMap<QString,Tileset>::iterator iter = tileSets.find(name);
+        if(iter == tileSets.end())
+            return false;
+        if(!sources.isEmpty() && iter.value().getTileSize() != sources[0]->getTileSize())
+            return false;
+        sources.append(&iter.value());
+    }
+
+    QString filePath = QString("tilesets") + QDir::separator() + newName;
+    QString tilesetDir = rootDir.absolutePath() + QDir::separator() + "tilesets" + QDir::separator();
+    QString datFile = getDataFilePath(filePath);
+    QString tilesFile = tilesetDir + newName + ".tiles.png";
+    QString entitiesFile = tilesetDir + newName + ".entities.png";
+
+    // Every file written here is removed again if the merge fails, so none may belong to something else
+    if(data.contains(filePath) || QFileInfo(datFile).exists() || QFileInfo(tilesFile).exists() ||
+       QFileInfo(entitiesFile).exists())
+        return false;
+
+    // Pack the atlas (a dummy entity set is created from it, as for new tilesets). Maps are only moved over once every
+    // file of the new tileset is written.
+    QHash<Tileset*,QMap<int,int>> remap;
+    Tileset merged;
+    if(!Tileset::createAtlas(newName, sources, getData(filePath), tilesFile, &merged, &remap) ||
+       !QFile::copy(tilesFile, entitiesFile))
+    {
+        data.remove(filePath);
+        QFile::remove(datFile);
+        QFile::remove(tilesFile);
+        QFile::remove(entitiesFile);
+        return false;
+    }
+
+    merged.setThumbnail(ThumbnailCache::load(tilesFile));
+    QMap<QString,Tileset>::iterator inserted = tileSets.insert(newName, merged);
+
+    // Point the tiles of every map using a source tileset at the new pattern IDs
+    for(QMap<QString,Map>::iterator iter = maps.begin(); iter != maps.end(); iter++)
+    {
+        Map& map = iter.value();
+        QHash<Tileset*,QMap<int,int>>::const_iterator patterns = remap.constFind(map.getTileSet());
+        if(patterns == remap.constEnd())
+            continue;
+
+        QVector<TileChange> changes;
+        for(int y = 0; y < map.getHeight(); y++)
+        {
+            for(int x = 0; x < map.getWidth(); x++)
+            {
+                int pattern = map.getTile(x, y).getPattern();
+                int newPattern = patterns.value().value(pattern, pattern);
+                if(newPattern != pattern)
+                    changes.append(TileChange(y * map.getWidth() + x, pattern, newPattern));
+            }
+        }
+
+        map.setTileSet(&inserted.value());
+        map.applyChanges(changes);
+        map.build(getData(QString("maps") + QDir::separator() + iter.key()));
+    }
+
+    return true;
+}
+
+QHash<int,int> Quest::getPatternUsage(QString tilesetName)
+{
+    PROFILE_SCOPE("Quest::getPatternUsage");
+
+    QList<Map*> users;
+    for(QMap<QString,Map>::iterator iter = maps.begin(); iter != maps.end(); iter++)
+    {
+        Tileset* tileset = iter.value().getTileSet();
+        if(tileset && tileset->getName() == tilesetName)
+            users.append(&iter.value());
+    }
+
+    // Each map is counted on its own, the histograms are merged as they come in
+    return QtConcurrent::blockingMappedReduced<PatternHistogram>(users, countPatterns, mergeHistogram);
+}
+
+int Quest::prunePatterns(QString tilesetName)
+{
+    PROFILE_SCOPE("Quest::prunePatterns");
+
+    QMap<QString,Tileset>::iterator tileset = tileSets.find(tilesetName);
+    if(tileset == tileSets.end())
+        return -1;
+
+    PatternHistogram usage = getPatternUsage(tilesetName);
+    int before = tileset.value().getPatterns()->size();
+    QMap<int,int> remap = tileset.value().compactPatterns(usage.keys().toSet());
+    int removed = before - tileset.value().getPatterns()->size();
+
+    // Point the tiles of every map using the tileset at the renumbered patterns
+    for(QMap<QString,Map>::iterator iter = maps.begin(); iter != maps.end(); iter++)
+    {
+        Map& map = iter.value();
+        if(map.getTileSet() != &tileset.value())
+            continue;
+
+        QVector<TileChange> changes;
+        for(int y = 0; y < map.getHeight(); y++)
+        {
+            for(int x = 0; x < map.getWidth(); x++)
+            {
+                int pattern = map.getTile(x, y).getPattern();
+                int newPattern = remap.value(pattern, pattern);
+                if(newPattern != pattern)
+                    changes.append(TileChange(y * map.getWidth() + x, pattern, newPattern));
+            }
+        }
+
+        if(changes.isEmpty())
+            continue;
+
+        map.applyChanges(changes);
+        map.build(getData(QString("maps") + QDir::separator() + iter.key()));
+    }
+
+    return removed;
+}
+
+QStringList Quest::generateWorld(WorldSettings settings, QVector<qreal>* backtracking)
+{
+    PROFILE_SCOPE("Quest::generateWorld");
+
+    QMap<QString,Tileset>::iterator tileset = tileSets.find(settings.tileset);
+    if(tileset == tileSets.end() || settings.width < MIN_AREA_WIDTH + 2 || settings.height < 3)
+        return QStringList();
+
+    // Map IDs are file names, which Solarus expects in lower case
+    settings.prefix = settings.prefix.isEmpty() ? QString("world") : settings.prefix.toLower();
+    settings.tileSize = tileset.value().getTileSize();
+
+    // Fall back on the tileset's first walkable and first blocking patterns
+    for(const TilePattern& pattern : *tileset.value().getPatterns())
+    {
+        if(settings.floorPattern == NO_PATTERN && pattern.traversable)
+            settings.floorPattern = pattern.id;
+        if(settings.wallPattern == NO_PATTERN && !pattern.traversable)
+            settings.wallPattern = pattern.id;
+    }
+    if(settings.floorPattern == NO_PATTERN)
+        return QStringList();
+    if(settings.wallPattern == NO_PATTERN)
+        settings.wallPattern = settings.floorPattern;
+
+    QList<WorldMap> plans = WorldGenerator::plan(WorldGenerator::splitMission(mission.getItems()), settings);
+    for(const WorldMap& plan : plans)
+    {
+        QString filePath = QString("maps") + QDir::separator() + plan.name;
+        if(maps.contains(plan.name) || data.contains(filePath) || QFileInfo(getDataFilePath(filePath)).exists())
+            return QStringList();
+    }
+
+    QList<WorldMap> world = WorldGenerator::generate(plans);
+
+    // A world missing keys cannot be finished, so nothing is added
+    QStringList unplaced;
+    for(const WorldMap& generated : world)
+        unplaced += generated.unplacedKeys;
+    if(!unplaced.isEmpty())
+    {
+        qWarning() << "No room on the generated maps for keys:" << unplaced;
+        return QStringList();
+    }
+
+    Table* database = getData(DAT_DATABASE);
+    QSet<QString> listed;
+    for(Object* object : database->getObjectsOfName(OBJ_MAP))
+        listed.insert(object->find(ELE_ID));
+
+    // Tables are written on the main thread, each map links to its neighbours by name
+    QStringList names;
+    for(int i = 0; i < world.size(); i++)
+    {
+        WorldMap& generated = world[i];
+        generated.map.setTileSet(&tileset.value());
+
+        QString previous = i > 0 ? world[i - 1].name : QString();
+        QString next = i < world.size() - 1 ? world[i + 1].name : QString();
+        for(const MapEntity& link : WorldGenerator::buildLinks(generated, previous, next))
+            generated.map.addEntity(link);
+        for(const MapEntity& entity : WorldGenerator::buildMission(generated, mission.getItems()))
+            generated.map.addEntity(entity);
+
+        if(backtracking != nullptr)
+        {
+            WorldGenerator::measure(generated);
+            backtracking->append(generated.backtracking);
+        }
+
+        Table* table = getData(QString("maps") + QDir::separator() + generated.name);
+        generated.map.build(table);
+
+        writeToFile(QFileInfo(table->getFilePath()).absoluteDir().absolutePath(), generated.name + ".lua", ""); // Write map script file
+
+        Object entry = generated.map.getObject();
+        if(!listed.contains(entry.find(ELE_ID)))
+            database->addObject(OBJ_MAP, entry);
+
+        maps.insert(generated.name, generated.map);
+        names.append(generated.name);
+    }
+
+    return names;
+}
+
+void Quest::linkMap(QString name, Map& map, Tileset* tileset)
+{
+    if(tileset->getTileSize() > 0 && map.getTileSize() != tileset->getTileSize())
+        map.replaceContents(Map::parse(name, getData(QString("maps") + QDir::separator() + name), tileset->getTileSize()));
+
+    map.setTileSet(tileset);
+}
+
+QuestIndex* Quest::getIndex()
+{
+    index.update(this);
+    return &index;
+}
+
 bool Quest::checkForChanges()
 {
     QMap<QString,QSharedPointer<Table>>::iterator iter;
 
-    // Loop through all loaded data, loading in tables from the disk with the same file names. Check them for equality.
+    // Loop through all loaded data. Tables track their own modifications, so nothing needs to be re-read from the disk.
     for(iter = data.begin(); iter != data.end(); iter++)
     {
-        Table onDisk(iter.value().data()->getFilePath());
+        Table* table = iter.value().data();
 
-        // If the data does not exist on disk, or the data in memory differs from that on the disk, changes were made.
-        if(!iter.value().data()->areEqual(&onDisk) || !onDisk.existsOnDisk())
+        // If the data does not exist on disk, or the data in memory has been modified, changes were made.
+        if(table->isModified() || !table->existsOnDisk())
             return true;
     }
 
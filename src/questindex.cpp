@@ -0,0 +1,188 @@
+#include "questindex.h"
+
+#include <QtConcurrent>
+
+#include "quest.h"
+#include "profiler.h"
+
+namespace
+{
+
+const QChar TERM_SEPARATOR = QChar(0x1f); /*!< Separates the parts of a term, never found in table text. */
+const QChar VALUE_PART_SEPARATOR = ':';   /*!< Separates the parts of list values, such as a gate's key links. */
+
+inline QString elementTerm(const QString& objectName, const QString& element, const QString& value)
+{
+    return objectName + TERM_SEPARATOR + element + TERM_SEPARATOR + value;
+}
+
+inline QString valueTerm(const QString& value)
+{
+    return TERM_SEPARATOR + value;
+}
+
+/*!
+ * \brief Collects the terms of a single table. Runs on a worker thread, the table is only read.
+ */
+QuestIndex::TableTerms indexTable(const QPair<QString,Table*>& job)
+{
+    PROFILE_SCOPE("QuestIndex::indexTable");
+
+    Table* table = job.second;
+
+    QuestIndex::TableTerms indexed;
+    indexed.revision = table->getRevision();
+
+    for(Object* object : table->getObjects())
+    {
+        QString name = table->getObjectName(object);
+        indexed.terms[name]++;
+
+        for(ObjectData::const_iterator iter = object->data.constBegin(); iter != object->data.constEnd(); iter++)
+        {
+            indexed.terms[elementTerm(name, iter.key(), iter.value())]++;
+            indexed.terms[valueTerm(iter.value())]++;
+
+            if(iter.value().contains(VALUE_PART_SEPARATOR))
+            {
+                for(const QString& part : iter.value().split(VALUE_PART_SEPARATOR, QString::SkipEmptyParts))
+                {
+                    indexed.terms[elementTerm(name, iter.key(), part)]++;
+                    indexed.terms[valueTerm(part)]++;
+                }
+            }
+        }
+    }
+
+    return indexed;
+}
+
+} // namespace
+
+QuestIndex::QuestIndex()
+{
+
+}
+
+void QuestIndex::update(Quest* quest)
+{
+    PROFILE_SCOPE("QuestIndex::update");
+
+    QList<QPair<QString,Table*>> stale;
+    QSet<QString> loaded;
+
+    for(const QString& filePath : quest->getDataPaths())
+    {
+        Table* table = quest->getData(filePath);
+        loaded.insert(filePath);
+
+        QHash<QString,TableTerms>::const_iterator iter = tables.constFind(filePath);
+        if(iter == tables.constEnd() || iter.value().revision != table->getRevision())
+            stale.append(qMakePair(filePath, table));
+    }
+
+    // Forget tables the quest no longer has
+    for(const QString& filePath : tables.keys())
+    {
+        if(!loaded.contains(filePath))
+            removeTable(filePath);
+    }
+
+    if(stale.isEmpty())
+        return;
+
+    // Tables are indexed independently, and merged into the postings here
+    QList<TableTerms> results = QtConcurrent::blockingMapped<QList<TableTerms>>(stale, indexTable);
+    for(int i = 0; i < stale.size(); i++)
+    {
+        removeTable(stale[i].first);
+        addTable(stale[i].first, results[i]);
+    }
+
+    PROFILE_COUNTER("QuestIndex tables re-indexed", stale.size());
+}
+
+void QuestIndex::clear()
+{
+    tables.clear();
+    postings.clear();
+}
+
+void QuestIndex::removeTable(const QString& filePath)
+{
+    QHash<QString,TableTerms>::iterator iter = tables.find(filePath);
+    if(iter == tables.end())
+        return;
+
+    for(QHash<QString,int>::const_iterator term = iter.value().terms.constBegin(); term != iter.value().terms.constEnd(); term++)
+    {
+        QHash<QString,QHash<QString,int>>::iterator posting = postings.find(term.key());
+        if(posting == postings.end())
+            continue;
+
+        posting.value().remove(filePath);
+        if(posting.value().isEmpty())
+            postings.erase(posting);
+    }
+
+    tables.erase(iter);
+}
+
+void QuestIndex::addTable(const QString& filePath, const TableTerms& indexed)
+{
+    for(QHash<QString,int>::const_iterator term = indexed.terms.constBegin(); term != indexed.terms.constEnd(); term++)
+        postings[term.key()].insert(filePath, term.value());
+
+    tables.insert(filePath, indexed);
+}
+
+QStringList QuestIndex::lookup(const QString& term) const
+{
+    QStringList paths = postings.value(term).keys();
+    paths.sort();
+    return paths;
+}
+
+QStringList QuestIndex::findObjects(QString objectName) const
+{
+    return lookup(objectName);
+}
+
+QStringList QuestIndex::find(QString objectName, QString element, QString value) const
+{
+    return lookup(elementTerm(objectName, element, value));
+}
+
+QStringList QuestIndex::findValue(QString value) const
+{
+    return lookup(valueTerm(value));
+}
+
+int QuestIndex::count(QString filePath, QString objectName, QString element, QString value) const
+{
+    return postings.value(elementTerm(objectName, element, value)).value(filePath, 0);
+}
+
+QStringList QuestIndex::getMapsUsingTileset(QString tileset) const
+{
+    QStringList maps;
+    for(const QString& filePath : find(OBJ_PROPERTIES, ELE_TILESET, tileset))
+    {
+        if(filePath.section(QDir::separator(), 0, 0) == "maps")
+            maps.append(filePath.section(QDir::separator(), 1));
+    }
+    return maps;
+}
+
+QStringList QuestIndex::getMapsUsingPattern(QString tileset, int id) const
+{
+    QHash<QString,int> usingPattern = postings.value(elementTerm(OBJ_TILE, ELE_PATTERN, QString::number(id)));
+
+    QStringList maps;
+    for(const QString& map : getMapsUsingTileset(tileset))
+    {
+        if(usingPattern.contains(QString("maps") + QDir::separator() + map))
+            maps.append(map);
+    }
+    return maps;
+}
@@ -0,0 +1,95 @@
+#include "questloader.h"
+
+#include <QtConcurrent>
+
+#include "thumbnailcache.h"
+#include "profiler.h"
+
+namespace
+{
+
+/*!
+ * \brief Reads a single table, and the thumbnail of a tileset. Runs on a worker thread. Full tileset images are not
+ *        decoded, unless their thumbnail is not cached yet.
+ */
+LoadedData loadData(const LoadedData& job)
+{
+    PROFILE_SCOPE("QuestLoader::loadData");
+
+    LoadedData result = job;
+    result.table = QSharedPointer<Table>(new Table(job.dataPath));
+
+    if(job.filePath.section(QDir::separator(), 0, 0) == "tilesets")
+        result.thumbnail = ThumbnailCache::load(Tileset::getImagePath(job.filePath.section(QDir::separator(), 1), job.dataPath));
+
+    return result;
+}
+
+} // namespace
+
+QuestLoader::QuestLoader(Quest* quest, QObject *parent) :
+    QObject(parent)
+{
+    this->quest = quest;
+    loaded = 0;
+
+    connect(&loader, SIGNAL(resultReadyAt(int)), this, SLOT(resultReady(int)));
+    connect(&loader, SIGNAL(finished()), this, SLOT(loadFinished()));
+}
+
+QuestLoader::~QuestLoader()
+{
+    // Tables that never made it into the quest are freed along with the results, including those a canceled future drops
+    if(loader.isRunning())
+    {
+        loader.cancel();
+        loader.waitForFinished();
+    }
+}
+
+void QuestLoader::start()
+{
+    QList<LoadedData> jobs;
+    for(const QString& filePath : quest->getContentPaths())
+    {
+        LoadedData job;
+        job.filePath = filePath;
+        job.dataPath = quest->getDataFilePath(filePath);
+        jobs.append(job);
+    }
+
+    added = QVector<bool>(jobs.size(), false);
+    loaded = 0;
+    emit progressChanged(0, jobs.size());
+
+    loader.setFuture(QtConcurrent::mapped(jobs, loadData));
+}
+
+void QuestLoader::cancel()
+{
+    loader.cancel();
+}
+
+void QuestLoader::resultReady(int index)
+{
+    if(loader.isCanceled() || added[index])
+        return;
+
+    LoadedData result = loader.resultAt(index);
+    quest->addLoadedData(result.filePath, result.table, result.thumbnail);
+    added[index] = true;
+    loaded++;
+
+    QString name = result.filePath.section(QDir::separator(), 1);
+    if(result.filePath.section(QDir::separator(), 0, 0) == "tilesets")
+        emit tilesetLoaded(name);
+    else
+        emit mapLoaded(name);
+
+    emit progressChanged(loaded, added.size());
+}
+
+void QuestLoader::loadFinished()
+{
+    emit finished(loader.isCanceled());
+}
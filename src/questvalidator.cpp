@@ -0,0 +1,267 @@
+#include "questvalidator.h"
+
+#include <QtConcurrent>
+
+#include "profiler.h"
+
+namespace
+{
+
+/*!
+ * \brief Where Solarus looks for each kind of resource listed in the quest database.
+ */
+struct ResourceKind
+{
+    const char* name;
+    const char* directory;
+    QStringList extensions; /*!< An empty extension means the resource is a directory. */
+};
+
+const QList<ResourceKind> RESOURCE_KINDS =
+{
+    { "map",      "maps",      { ".dat" } },
+    { "tileset",  "tilesets",  { ".dat" } },
+    { "sprite",   "sprites",   { ".dat" } },
+    { "music",    "musics",    { ".ogg", ".it", ".spc" } },
+    { "sound",    "sounds",    { ".ogg" } },
+    { "item",     "items",     { ".lua" } },
+    { "enemy",    "enemies",   { ".lua" } },
+    { "language", "languages", { "" } },
+    { "font",     "fonts",     { ".png", ".ttf", ".ttc", ".fon" } }
+};
+
+QList<ValidationIssue> checkMap(const ValidationJob& job)
+{
+    QList<ValidationIssue> issues;
+
+    if(!job.tilesetFound)
+    {
+        issues.append(ValidationIssue(ValidationIssue::Error, job.filePath,
+                                      "Uses tileset \"" + job.tilesetName + "\", which is not part of the quest."));
+        return issues;
+    }
+
+    // Tiles with the same missing pattern are reported once, at the first of them
+    QMap<int,QPair<QPoint,int>> missing; // First tile and number of tiles, by pattern ID
+    for(int y = 0; y < job.map.getHeight(); y++)
+    {
+        for(int x = 0; x < job.map.getWidth(); x++)
+        {
+            int pattern = job.map.getTile(x, y).getPattern();
+            if(job.patternIds.contains(pattern))
+                continue;
+
+            QMap<int,QPair<QPoint,int>>::iterator iter = missing.find(pattern);
+            if(iter == missing.end())
+                missing.insert(pattern, qMakePair(QPoint(x, y), 1));
+            else
+                iter.value().second++;
+        }
+    }
+
+    for(QMap<int,QPair<QPoint,int>>::const_iterator iter = missing.constBegin(); iter != missing.constEnd(); iter++)
+    {
+        issues.append(ValidationIssue(ValidationIssue::Error, job.filePath,
+                                      QString("%1 tile(s) use pattern %2, which tileset \"%3\" does not have.")
+                                      .arg(iter.value().second).arg(iter.key()).arg(job.tilesetName),
+                                      iter.value().first));
+    }
+
+    return issues;
+}
+
+QList<ValidationIssue> checkMission(const ValidationJob& job)
+{
+    QList<ValidationIssue> issues;
+
+    QSet<QString> keys, gates;
+    for(const QPair<QString,Object>& object : job.objects)
+    {
+        if(object.first != OBJ_KEY_EVENT)
+            continue;
+
+        QString name = object.second.data.value(ELE_NAME);
+        if(keys.contains(name))
+            issues.append(ValidationIssue(ValidationIssue::Warning, job.filePath, "Key \"" + name + "\" is defined more than once."));
+        keys.insert(name);
+    }
+
+    // Gates are checked against the table, the parsed mission silently drops links to missing keys
+    for(const QPair<QString,Object>& object : job.objects)
+    {
+        if(object.first != OBJ_GATE)
+            continue;
+
+        QString name = object.second.data.value(ELE_NAME);
+        if(gates.contains(name))
+            issues.append(ValidationIssue(ValidationIssue::Warning, job.filePath, "Gate \"" + name + "\" is defined more than once."));
+        gates.insert(name);
+
+        for(const QString& key : object.second.data.value(ELE_KEY_LINKS).split(':', QString::SkipEmptyParts))
+        {
+            if(!keys.contains(key))
+                issues.append(ValidationIssue(ValidationIssue::Error, job.filePath,
+                                              "Gate \"" + name + "\" requires key \"" + key + "\", which does not exist."));
+        }
+    }
+
+    return issues;
+}
+
+QList<ValidationIssue> checkDatabase(const ValidationJob& job)
+{
+    QList<ValidationIssue> issues;
+    QSet<QString> listedMaps;
+
+    for(const QPair<QString,Object>& object : job.objects)
+    {
+        QString id = object.second.data.value(ELE_ID);
+        if(object.first == OBJ_MAP)
+            listedMaps.insert(id);
+
+        for(const ResourceKind& kind : RESOURCE_KINDS)
+        {
+            if(object.first != kind.name)
+                continue;
+
+            QString basePath = job.rootPath + QDir::separator() + kind.directory + QDir::separator() + id;
+            bool found = false;
+            for(const QString& extension : kind.extensions)
+            {
+                QFileInfo info(basePath + extension);
+                if(extension.isEmpty() ? info.isDir() : info.isFile())
+                {
+                    found = true;
+                    break;
+                }
+            }
+
+            if(!found)
+                issues.append(ValidationIssue(ValidationIssue::Error, job.filePath,
+                                              "Lists " + object.first + " \"" + id + "\", but no file for it was found."));
+            break;
+        }
+    }
+
+    for(const QString& map : job.mapNames)
+    {
+        if(!listedMaps.contains(map))
+            issues.append(ValidationIssue(ValidationIssue::Warning, job.filePath, "Map \"" + map + "\" is not listed."));
+    }
+
+    return issues;
+}
+
+/*!
+ * \brief Runs a single check. Runs on a worker thread.
+ */
+QList<ValidationIssue> runCheck(const ValidationJob& job)
+{
+    PROFILE_SCOPE("QuestValidator::runCheck");
+
+    switch(job.kind)
+    {
+    case ValidationJob::MapCheck:       return checkMap(job);
+    case ValidationJob::MissionCheck:   return checkMission(job);
+    case ValidationJob::DatabaseCheck:  return checkDatabase(job);
+    }
+
+    return QList<ValidationIssue>();
+}
+
+/*!
+ * \brief Copies every object of a table, along with its name.
+ */
+QList<QPair<QString,Object>> copyObjects(Table* table)
+{
+    QList<QPair<QString,Object>> objects;
+    for(Object* object : table->getObjects())
+        objects.append(qMakePair(table->getObjectName(object), *object));
+    return objects;
+}
+
+} // namespace
+
+QuestValidator::QuestValidator(Quest* quest, QObject *parent) :
+    QObject(parent)
+{
+    this->quest = quest;
+    checked = total = 0;
+
+    connect(&validator, SIGNAL(resultReadyAt(int)), this, SLOT(resultReady(int)));
+    connect(&validator, SIGNAL(finished()), this, SLOT(validationFinished()));
+}
+
+QuestValidator::~QuestValidator()
+{
+    if(validator.isRunning())
+    {
+        validator.cancel();
+        validator.waitForFinished();
+    }
+}
+
+void QuestValidator::start()
+{
+    QList<ValidationJob> jobs;
+
+    // Maps share their tiles with the copies made here, nothing is duplicated unless the map is edited meanwhile
+    for(QMap<QString,Map>::iterator iter = quest->getMaps()->begin(); iter != quest->getMaps()->end(); iter++)
+    {
+        ValidationJob job;
+        job.kind = ValidationJob::MapCheck;
+        job.filePath = QString("maps") + QDir::separator() + iter.key();
+        job.map = iter.value();
+        job.tilesetName = quest->getData(job.filePath)->getElementValue(OBJ_PROPERTIES, ELE_TILESET);
+
+        Tileset* tileset = quest->getTileset(job.tilesetName);
+        job.tilesetFound = tileset != nullptr;
+        if(tileset)
+            job.patternIds = tileset->getPatterns()->keys().toSet();
+
+        jobs.append(job);
+    }
+
+    ValidationJob mission;
+    mission.kind = ValidationJob::MissionCheck;
+    mission.filePath = DAT_MISSION_ITEMS;
+    mission.objects = copyObjects(quest->getData(DAT_MISSION_ITEMS));
+    jobs.append(mission);
+
+    ValidationJob database;
+    database.kind = ValidationJob::DatabaseCheck;
+    database.filePath = DAT_DATABASE;
+    database.objects = copyObjects(quest->getData(DAT_DATABASE));
+    database.rootPath = quest->getRootDir().absolutePath();
+    database.mapNames = quest->getMaps()->keys();
+    jobs.append(database);
+
+    checked = 0;
+    total = jobs.size();
+    emit progressChanged(0, total);
+
+    validator.setFuture(QtConcurrent::mapped(jobs, runCheck));
+}
+
+void QuestValidator::cancel()
+{
+    validator.cancel();
+}
+
+void QuestValidator::resultReady(int index)
+{
+    if(validator.isCanceled())
+        return;
+
+    checked++;
+    QList<ValidationIssue> issues = validator.resultAt(index);
+    if(!issues.isEmpty())
+        emit issuesFound(issues);
+
+    emit progressChanged(checked, total);
+}
+
+void QuestValidator::validationFinished()
+{
+    emit finished(validator.isCanceled());
+}
@@ -0,0 +1,141 @@
+#include "questwatcher.h"
+
+#include <QtConcurrent>
+#include <QFileInfo>
+
+QuestWatcher::QuestWatcher(Quest* quest, QObject *parent) :
+    QObject(parent)
+{
+    this->quest = quest;
+    parsing = false;
+
+    debounce.setSingleShot(true);
+    debounce.setInterval(QUEST_WATCH_DEBOUNCE);
+
+    connect(&watcher, SIGNAL(fileChanged(QString)), this, SLOT(fileChanged(QString)));
+    connect(&debounce, SIGNAL(timeout()), this, SLOT(processPending()));
+    connect(&parser, SIGNAL(finished()), this, SLOT(parseFinished()));
+}
+
+QuestWatcher::~QuestWatcher()
+{
+    // Tables parsed for a reload that never finished still have to be freed
+    if(parsing)
+    {
+        parser.waitForFinished();
+        for(const ParsedTable& parsed : parser.result())
+            delete parsed.table;
+    }
+}
+
+void QuestWatcher::watchLoadedData()
+{
+    for(const QString& filePath : quest->getDataPaths())
+    {
+        QString absolutePath = quest->getData(filePath)->getFilePath();
+        if(watchedPaths.contains(absolutePath) || !QFileInfo(absolutePath).exists())
+            continue;
+
+        watchedPaths.insert(absolutePath, filePath);
+        watcher.addPath(absolutePath);
+    }
+}
+
+void QuestWatcher::reload(const QStringList& filePaths)
+{
+    for(const QString& filePath : filePaths)
+    {
+        pending.insert(filePath);
+        forced.insert(filePath);
+    }
+
+    if(!parsing)
+        processPending();
+}
+
+void QuestWatcher::fileChanged(const QString& absolutePath)
+{
+    QHash<QString,QString>::const_iterator iter = watchedPaths.constFind(absolutePath);
+    if(iter == watchedPaths.constEnd())
+        return;
+
+    // Editors that save by replacing the file cause it to drop out of the watch list
+    if(!watcher.files().contains(absolutePath) && QFileInfo(absolutePath).exists())
+        watcher.addPath(absolutePath);
+
+    pending.insert(iter.value());
+    debounce.start();
+}
+
+void QuestWatcher::processPending()
+{
+    if(parsing || pending.isEmpty())
+        return; // Pending tables are picked up once the current reload finishes
+
+    QList<QPair<QString,QString>> jobs; // Relative and absolute path of each table to parse
+    QStringList conflicts;
+
+    for(const QString& filePath : pending)
+    {
+        Table* table = quest->getData(filePath);
+        bool force = forced.contains(filePath);
+
+        if(!force && !table->changedOnDisk())
+            continue; // Written by the editor itself, or touched without changing
+        if(!force && table->isModified())
+        {
+            conflicts.append(filePath);
+            continue;
+        }
+
+        jobs.append(qMakePair(filePath, table->getFilePath()));
+    }
+
+    pending.clear();
+    forced.clear();
+
+    if(!conflicts.isEmpty())
+        emit conflictDetected(conflicts);
+
+    if(jobs.isEmpty())
+        return;
+
+    parsing = true;
+    parser.setFuture(QtConcurrent::run([jobs]()
+    {
+        QList<ParsedTable> results;
+        for(const QPair<QString,QString>& job : jobs)
+            results.append(ParsedTable(job.first, new Table(job.second)));
+        return results;
+    }));
+}
+
+void QuestWatcher::parseFinished()
+{
+    QList<ParsedTable> results = parser.result();
+    parsing = false;
+
+    for(const ParsedTable& parsed : results)
+    {
+        if(quest->reloadData(parsed.filePath, parsed.table))
+        {
+            QString folder = parsed.filePath.section(QDir::separator(), 0, 0);
+            QString name = parsed.filePath.section(QDir::separator(), 1);
+
+            if(parsed.filePath == DAT_MISSION_ITEMS)
+                emit missionReloaded();
+            else if(folder == "maps")
+                emit mapReloaded(name);
+            else if(folder == "tilesets")
+                emit tilesetReloaded(name);
+
+            emit dataReloaded(parsed.filePath);
+        }
+
+        delete parsed.table;
+    }
+
+    // Changes that arrived while parsing
+    if(!pending.isEmpty())
+        debounce.start();
+}
@@ -0,0 +1,198 @@
+#include "spatialhash.h"
+
+#include <algorithm>
+
+namespace
+{
+
+/*!
+ * \brief Divides, rounding towards negative infinity.
+ */
+inline int floorDiv(int value, int divisor)
+{
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+} // namespace
+
+SpatialHash::SpatialHash(int cellSize)
+{
+    this->cellSize = qMax(1, cellSize);
+}
+
+void SpatialHash::insert(int id, const QRect& bounds)
+{
+    if(items.contains(id))
+    {
+        move(id, bounds);
+        return;
+    }
+
+    items.insert(id, bounds);
+    addToCells(id, getCells(bounds));
+}
+
+bool SpatialHash::remove(int id)
+{
+    QHash<int,QRect>::iterator iter = items.find(id);
+    if(iter == items.end())
+        return false;
+
+    removeFromCells(id, getCells(iter.value()));
+    items.erase(iter);
+    return true;
+}
+
+bool SpatialHash::move(int id, const QRect& bounds)
+{
+    QHash<int,QRect>::iterator iter = items.find(id);
+    if(iter == items.end())
+        return false;
+
+    QRect oldRange = getCells(iter.value());
+    QRect newRange = getCells(bounds);
+    iter.value() = bounds;
+
+    if(oldRange != newRange)
+    {
+        removeFromCells(id, oldRange);
+        addToCells(id, newRange);
+    }
+    return true;
+}
+
+void SpatialHash::rebuild(const QVector<QPair<int,QRect>>& rectangles)
+{
+    clear();
+    items.reserve(rectangles.size());
+    cells.reserve(rectangles.size());
+
+    for(const QPair<int,QRect>& rectangle : rectangles)
+    {
+        items.insert(rectangle.first, rectangle.second);
+        addToCells(rectangle.first, getCells(rectangle.second));
+    }
+}
+
+void SpatialHash::clear()
+{
+    cells.clear();
+    items.clear();
+}
+
+QList<int> SpatialHash::query(const QRect& area) const
+{
+    QList<int> found;
+    if(area.isEmpty())
+        return found;
+
+    QRect range = getCells(area);
+    visitCells(range, [&](int x, int y, const QVector<int>& ids)
+    {
+        for(int id : ids)
+        {
+            // Rectangles covering several cells are only reported from the first cell they share with the area
+            const QRect bounds = items.value(id);
+            QRect covered = getCells(bounds);
+            if(qMax(covered.left(), range.left()) != x || qMax(covered.top(), range.top()) != y)
+                continue;
+
+            if(bounds.intersects(area) || (bounds.isEmpty() && area.contains(bounds.topLeft())))
+                found.append(id);
+        }
+        return true;
+    });
+
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+QList<int> SpatialHash::query(const QPoint& point) const
+{
+    return query(QRect(point, QSize(1, 1)));
+}
+
+bool SpatialHash::intersects(const QRect& area, int ignore) const
+{
+    if(area.isEmpty())
+        return false;
+
+    bool found = false;
+    visitCells(getCells(area), [&](int, int, const QVector<int>& ids)
+    {
+        for(int id : ids)
+        {
+            if(id != ignore && items.value(id).intersects(area))
+            {
+                found = true;
+                return false;
+            }
+        }
+        return true;
+    });
+
+    return found;
+}
+
+QRect SpatialHash::getCells(const QRect& bounds) const
+{
+    // Empty rectangles still belong to the cell they are positioned in
+    QRect area = bounds.isEmpty() ? QRect(bounds.topLeft(), QSize(1, 1)) : bounds;
+
+    return QRect(QPoint(floorDiv(area.left(), cellSize), floorDiv(area.top(), cellSize)),
+                 QPoint(floorDiv(area.right(), cellSize), floorDiv(area.bottom(), cellSize)));
+}
+
+template<typename Visitor>
+void SpatialHash::visitCells(const QRect& range, Visitor visit) const
+{
+    if(static_cast<qint64>(range.width()) * range.height() <= cells.size())
+    {
+        for(int y = range.top(); y <= range.bottom(); y++)
+        {
+            for(int x = range.left(); x <= range.right(); x++)
+            {
+                QHash<quint64,QVector<int>>::const_iterator cell = cells.constFind(cellKey(x, y));
+                if(cell != cells.constEnd() && !visit(x, y, cell.value()))
+                    return;
+            }
+        }
+    }
+    else
+    {
+        // Large areas over a sparse index, only the cells that exist are looked at
+        for(QHash<quint64,QVector<int>>::const_iterator cell = cells.constBegin(); cell != cells.constEnd(); cell++)
+        {
+            int x = static_cast<qint32>(cell.key() >> 32);
+            int y = static_cast<qint32>(cell.key() & 0xffffffff);
+            if(range.contains(x, y) && !visit(x, y, cell.value()))
+                return;
+        }
+    }
+}
+
+void SpatialHash::addToCells(int id, const QRect& range)
+{
+    for(int y = range.top(); y <= range.bottom(); y++)
+    {
+        for(int x = range.left(); x <= range.right(); x++)
+            cells[cellKey(x, y)].append(id);
+    }
+}
+
+void SpatialHash::removeFromCells(int id, const QRect& range)
+{
+    for(int y = range.top(); y <= range.bottom(); y++)
+    {
+        for(int x = range.left(); x <= range.right(); x++)
+        {
+            QHash<quint64,QVector<int>>::iterator cell = cells.find(cellKey(x, y));
+            if(cell == cells.end())
+                continue;
+
+            cell.value().removeOne(id);
+            if(cell.value().isEmpty())
+                cells.erase(cell);
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#include "thumbnailcache.h"
+#include "imagepyramid.h"
+
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+
+QImage ThumbnailCache::load(QString imagePath)
+{
+    QFile file(imagePath);
+    if(!file.open(QIODevice::ReadOnly))
+        return QImage();
+
+    // Hashing the file is far cheaper than decoding it
+    QByteArray contents = file.readAll();
+    file.close();
+    QString hash = QCryptographicHash::hash(contents, QCryptographicHash::Sha1).toHex();
+
+    QString cachePath = getCacheDir() + QDir::separator() + hash + ".png";
+    QImage thumbnail(cachePath);
+    if(!thumbnail.isNull())
+        return thumbnail;
+
+    // Cache miss, decode the image from the bytes already read
+    thumbnail = ImagePyramid::build(QImage::fromData(contents)).getThumbnail();
+    if(thumbnail.isNull())
+        return thumbnail;
+
+    // Written to a temporary file and renamed, in case another thread is storing the same thumbnail
+    QDir().mkpath(getCacheDir());
+    QSaveFile cacheFile(cachePath);
+    if(cacheFile.open(QIODevice::WriteOnly) && thumbnail.save(&cacheFile, "PNG"))
+        cacheFile.commit();
+
+    return thumbnail;
+}
+
+QString ThumbnailCache::getCacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QDir::separator() + "thumbnails";
+}
@@ -1,5 +1,61 @@
 #include "tileset.h"
 
+#include <QPainter>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
+
+#include "atlaspacker.h"
+#include "profiler.h"
+
+namespace
+{
+
+/*!
+ * \brief Hashes the pixels of one cell of a 32-bit image, a scanline at a time, and checks whether the cell is fully
+ *        transparent.
+ */
+uint hashCell(const QImage& image, int x, int y, int size, bool* blank)
+{
+    uint hash = 0;
+    QRgb bits = 0;
+    const int rowBytes = size * sizeof(QRgb);
+
+    for(int row = 0; row < size; row++)
+    {
+        const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y + row)) + x;
+
+        // The alpha of the combined bits is only zero if every pixel's alpha is
+        for(int i = 0; i < size; i++)
+            bits |= line[i];
+
+        hash = qHashBits(line, rowBytes, hash);
+    }
+
+    *blank = qAlpha(bits) == 0;
+    return hash;
+}
+
+/*!
+ * \brief Compares the pixels of two cells of a 32-bit image.
+ */
+bool cellsEqual(const QImage& image, int x0, int y0, int x1, int y1, int size)
+{
+    const int rowBytes = size * sizeof(QRgb);
+
+    for(int row = 0; row < size; row++)
+    {
+        const QRgb* a = reinterpret_cast<const QRgb*>(image.constScanLine(y0 + row)) + x0;
+        const QRgb* b = reinterpret_cast<const QRgb*>(image.constScanLine(y1 + row)) + x1;
+        if(std::memcmp(a, b, rowBytes) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
 TilePattern::TilePattern()
 {
 
@@ -40,9 +96,27 @@ Object TilePattern::build()
     return obj;
 }
 
+bool TilePattern::update(Object* object) const
+{
+    bool changed = object->update(ELE_ID, QString::number(id));
+    changed |= object->update(ELE_DEFAULT_LAYER, QString::number(defaultLayer));
+    changed |= object->update(ELE_X, QString::number(x));
+    changed |= object->update(ELE_Y, QString::number(y));
+    changed |= object->update(ELE_WIDTH, QString::number(width));
+    changed |= object->update(ELE_HEIGHT, QString::number(height));
+
+    // Any ground other than traversable blocks movement, so it is only replaced if the pattern was toggled
+    if((object->find(ELE_GROUND, "traversable") == "traversable") != traversable)
+        changed |= object->update(ELE_GROUND, traversable ? "traversable" : "wall");
+
+    return changed;
+}
+
 Tileset::Tileset()
 {
     data = nullptr;
+    decoded = false;
+    prefetching = false;
 }
 
 Tileset::Tileset(QString name, Table* data)
@@ -57,47 +131,133 @@ Tileset::~Tileset()
 
 Tileset Tileset::parse(QString name, Table* data)
 {
+    PROFILE_SCOPE("Tileset::parse");
+
     Tileset tileset;
     tileset.data = data;
     tileset.name = name;
 
-    QString imgPath = QFileInfo(data->getFilePath()).dir().absolutePath() + QDir::separator() + name + ".tiles.png";
-    tileset.image = QPixmap(imgPath);
-
     // Construct the list of patterns from the data
     QList<Object*> patternList = data->getObjectsOfName(OBJ_TILE_PATTERN);
     for(Object* obj : patternList)
         tileset.patterns.insert(obj->data.find(ELE_ID).value().toInt(), TilePattern::parse(*obj));
 
-    // Determine the path of the tileset's image file.
-    QFileInfo file = QFileInfo(data->getFilePath());
-    QDir fileDir = file.absoluteDir();
-    QString imagePath = fileDir.absolutePath() + QDir::separator() + name + ".tiles.png";
-
-    // Assign sizes and load image
-    tileset.image = QPixmap(imagePath);
+    // Assign sizes from the image header, the image is only decoded once it is needed
+    tileset.imagePath = getImagePath(name, data->getFilePath());
+    QSize imageSize = QImageReader(tileset.imagePath).size();
+    if(!imageSize.isValid())
+        imageSize = QSize(0, 0); // Missing or unreadable image
     tileset.tileSize = patternList[0]->find(ELE_WIDTH).toInt();
-    tileset.width = tileset.image.width() / tileset.tileSize;
-    tileset.height =  tileset.image.height() / tileset.tileSize;
+    tileset.width = imageSize.width() / tileset.tileSize;
+    tileset.height = imageSize.height() / tileset.tileSize;
 
     return tileset;
 }
 
+QPixmap Tileset::getImage()
+{
+    if(image.isNull())
+    {
+        finishDecode();
+        if(pyramid.getLevelCount() > 0)
+            image = QPixmap::fromImage(pyramid.getLevel(0));
+    }
+    return image;
+}
+
+QFuture<ImagePyramid> Tileset::prefetchImage()
+{
+    if(!decoded && !prefetching && image.isNull())
+    {
+        decoding = QtConcurrent::run(decodeImage, imagePath);
+        prefetching = true;
+    }
+    return decoding;
+}
+
+bool Tileset::isImageReady()
+{
+    return decoded || !image.isNull() || (prefetching && decoding.isFinished());
+}
+
+ImagePyramid Tileset::getPyramid()
+{
+    finishDecode();
+    return pyramid;
+}
+
+void Tileset::finishDecode()
+{
+    if(decoded)
+        return;
+
+    // Waits for a prefetch, otherwise decodes on the calling thread
+    if(prefetching)
+        pyramid = decoding.result();
+    else if(!image.isNull())
+        pyramid = ImagePyramid::build(image.toImage());
+    else
+        pyramid = decodeImage(imagePath);
+
+    decoded = true;
+    prefetching = false;
+    decoding = QFuture<ImagePyramid>();
+}
+
+QString Tileset::getImagePath(QString name, QString dataFilePath)
+{
+    return QFileInfo(dataFilePath).absoluteDir().absolutePath() + QDir::separator() + name + ".tiles.png";
+}
+
 void Tileset::build(Tileset tileset)
 {
-    tileset.data->clear(); // Clear all existing data in the tileset
+    // Parsing keeps the last pattern with each ID, so earlier duplicates are dropped along with removed patterns
+    QHash<int,Object*> objects;
+    for(Object* obj : tileset.data->getObjectsOfName(OBJ_TILE_PATTERN))
+    {
+        int id = obj->find(ELE_ID).toInt();
+        Object*& slot = objects[id];
+        if(slot != nullptr)
+            tileset.data->removeObject(OBJ_TILE_PATTERN, slot);
+        slot = obj;
+    }
 
     QMap<int,TilePattern>::iterator iter;
     for(iter = tileset.patterns.begin(); iter != tileset.patterns.end(); iter++)
     {
-        tileset.data->addObject(OBJ_TILE_PATTERN, iter.value().build());
+        Object* obj = objects.take(iter.key());
+        if(obj == nullptr)
+            tileset.data->addObject(OBJ_TILE_PATTERN, iter.value().build());
+        else if(iter.value().update(obj))
+            tileset.data->markDirty(obj);
     }
 
-    tileset.data->saveToDisk();
+    for(Object* obj : objects)
+        tileset.data->removeObject(OBJ_TILE_PATTERN, obj);
+}
+
+void Tileset::buildPatterns(const QVector<int>& ids)
+{
+    QSet<int> pending;
+    for(int id : ids)
+        pending.insert(id);
+
+    for(Object* obj : data->getObjectsOfName(OBJ_TILE_PATTERN))
+    {
+        int id = obj->find(ELE_ID).toInt();
+        QMap<int,TilePattern>::const_iterator pattern = patterns.constFind(id);
+        if(!pending.contains(id) || pattern == patterns.constEnd())
+            continue;
+
+        if(pattern.value().update(obj))
+            data->markDirty(obj);
+    }
 }
 
-Tileset Tileset::create(QString name, QString filePath, Table* data, int tileSize)
+Tileset Tileset::create(QString name, QString filePath, Table* data, int tileSize, bool deduplicate, QMap<int,int>* cellPatterns)
 {
+    PROFILE_SCOPE("Tileset::create");
+
     Tileset tileset;
     tileset.name = name;
     tileset.tileSize = tileSize;
@@ -106,19 +266,64 @@ Tileset Tileset::create(QString name, QString filePath, Table* data, int tileSiz
     tileset.height = tileset.image.height()/tileSize;
     tileset.data = data;
 
+    // Cells are compared on 32-bit pixels, straight from the image's scanlines
+    QImage pixels;
+    if(deduplicate)
+        pixels = tileset.image.toImage().convertToFormat(QImage::Format_ARGB32);
+
+    QHash<uint,QList<int>> cellsByHash; // Cell index of each pattern, by the hash of the cell's pixels
     int id = 0;
+    int cell = 0;
 
     // Construct the patterns used by this tileset
     for(int x = 0; x < tileset.width; x++)
     {
-        for(int y = 0; y < tileset.height; y++)
+        for(int y = 0; y < tileset.height; y++, cell++)
         {
+            if(deduplicate)
+            {
+                bool blank;
+                uint hash = hashCell(pixels, x*tileSize, y*tileSize, tileSize, &blank);
+
+                if(blank) // Fully transparent cells get no pattern
+                {
+                    if(cellPatterns)
+                        cellPatterns->insert(cell, NO_PATTERN);
+                    continue;
+                }
+
+                // Use the pattern of an identical cell if there is one, hash collisions are ruled out by comparing pixels
+                int canonical = NO_PATTERN;
+                QList<int>& candidates = cellsByHash[hash];
+                for(int other : candidates)
+                {
+                    if(cellsEqual(pixels, x*tileSize, y*tileSize, (other / tileset.height)*tileSize,
+                                  (other % tileset.height)*tileSize, tileSize))
+                    {
+                        canonical = other;
+                        break;
+                    }
+                }
+
+                if(canonical != NO_PATTERN)
+                {
+                    if(cellPatterns)
+                        cellPatterns->insert(cell, cellPatterns->value(canonical));
+                    continue;
+                }
+
+                candidates.append(cell);
+            }
+
             TilePattern pattern;
             pattern.x = x*tileSize;
             pattern.y = y*tileSize;
             pattern.height = pattern.width = tileSize;
             pattern.traversable = true;
             pattern.id = id;
+
+            if(cellPatterns)
+                cellPatterns->insert(cell, id);
             id++;
 
             tileset.addPattern(pattern);
@@ -130,6 +335,148 @@ Tileset Tileset::create(QString name, QString filePath, Table* data, int tileSiz
     return tileset;
 }
 
+bool Tileset::createAtlas(QString name, QList<Tileset*> sources, Table* data, QString imagePath, Tileset* result,
+                          QHash<Tileset*,QMap<int,int>>* remap)
+{
+    PROFILE_SCOPE("Tileset::createAtlas");
+
+    struct PackedPattern
+    {
+        Tileset* source;
+        TilePattern pattern;
+        QPoint position;
+    };
+
+    Tileset tileset;
+    tileset.name = name;
+    tileset.tileSize = sources.isEmpty() ? ATLAS_ALIGNMENT : sources[0]->tileSize;
+    tileset.data = data;
+    tileset.imagePath = imagePath;
+
+    QList<PackedPattern> packed;
+    QList<QSize> sizes;
+    for(Tileset* source : sources)
+    {
+        for(TilePattern* pattern : source->getPatternList())
+        {
+            PackedPattern entry;
+            entry.source = source;
+            entry.pattern = *pattern;
+            packed.append(entry);
+            sizes.append(QSize(pattern->width, pattern->height));
+        }
+    }
+
+    // Tallest patterns go first, which keeps the skyline flat
+    std::stable_sort(packed.begin(), packed.end(), [](const PackedPattern& a, const PackedPattern& b)
+    {
+        if(a.pattern.height != b.pattern.height)
+            return a.pattern.height > b.pattern.height;
+        return a.pattern.width > b.pattern.width;
+    });
+
+    // Keep the atlas a whole number of tiles wide, so the pattern grid still lines up
+    int width = AtlasPacker::suggestWidth(sizes);
+    width = (width + tileset.tileSize - 1) / tileset.tileSize * tileset.tileSize;
+
+    AtlasPacker packer(width);
+    for(PackedPattern& entry : packed)
+    {
+        if(!packer.insert(QSize(entry.pattern.width, entry.pattern.height), &entry.position))
+            return false;
+    }
+
+    int height = (packer.getHeight() + tileset.tileSize - 1) / tileset.tileSize * tileset.tileSize;
+    QImage atlas(qMax(width, tileset.tileSize), qMax(height, tileset.tileSize), QImage::Format_ARGB32);
+    atlas.fill(Qt::transparent);
+
+    // Copy each pattern's pixels over from its source image, decoding each source only once
+    QHash<Tileset*,QImage> sourceImages;
+    QPainter painter(&atlas);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+
+    int id = 0;
+    for(PackedPattern& entry : packed)
+    {
+        QHash<Tileset*,QImage>::iterator source = sourceImages.find(entry.source);
+        if(source == sourceImages.end())
+            source = sourceImages.insert(entry.source, entry.source->getImage().toImage());
+
+        painter.drawImage(entry.position, source.value(),
+                          QRect(entry.pattern.x, entry.pattern.y, entry.pattern.width, entry.pattern.height));
+
+        if(remap)
+            (*remap)[entry.source].insert(entry.pattern.id, id);
+
+        TilePattern pattern = entry.pattern;
+        pattern.id = id++;
+        pattern.x = entry.position.x();
+        pattern.y = entry.position.y();
+
+        tileset.addPattern(pattern);
+    }
+
+    painter.end();
+
+    if(!atlas.save(imagePath, "PNG"))
+        return false;
+
+    // Patterns are written in ID order. A failed save leaves the table modified.
+    data->clear();
+    for(TilePattern* pattern : tileset.getPatternList())
+        data->addObject(OBJ_TILE_PATTERN, pattern->build());
+    data->saveToDisk();
+    if(data->isModified())
+        return false;
+
+    tileset.pyramid = ImagePyramid::build(atlas);
+    tileset.decoded = true;
+    tileset.image = QPixmap::fromImage(atlas);
+    tileset.width = atlas.width() / tileset.tileSize;
+    tileset.height = atlas.height() / tileset.tileSize;
+
+    *result = tileset;
+    return true;
+}
+
+QMap<int,int> Tileset::compactPatterns(const QSet<int>& keep)
+{
+    QMap<int,int> remap;
+    QMap<int,TilePattern> kept;
+    int id = 0;
+
+    for(QMap<int,TilePattern>::const_iterator iter = patterns.constBegin(); iter != patterns.constEnd(); iter++)
+    {
+        if(!keep.contains(iter.key()))
+            continue;
+
+        TilePattern pattern = iter.value();
+        pattern.id = id;
+        kept.insert(id, pattern);
+        remap.insert(iter.key(), id);
+        id++;
+    }
+
+    patterns = kept;
+
+    // Only the objects of removed or renumbered patterns change, the rest of the table is written back as it was
+    for(Object* obj : data->getObjectsOfName(OBJ_TILE_PATTERN))
+    {
+        int oldId = obj->find(ELE_ID).toInt();
+        QMap<int,int>::const_iterator newId = remap.constFind(oldId);
+
+        if(newId == remap.constEnd())
+            data->removeObject(OBJ_TILE_PATTERN, obj);
+        else if(newId.value() != oldId)
+        {
+            obj->insert(ELE_ID, QString::number(newId.value()));
+            data->markDirty(obj);
+        }
+    }
+
+    return remap;
+}
+
 QList<TilePattern*> Tileset::getPatternList()
 {
     QList<TilePattern*> patternList = QList<TilePattern*>();
@@ -141,22 +488,18 @@ QList<TilePattern*> Tileset::getPatternList()
     return patternList;
 }
 
-QVector<QVector<TilePattern*>> Tileset::getPatternGrid()
+PatternGrid Tileset::getPatternGrid()
 {
-    QList<TilePattern*> list = getPatternList();
-    QVector<QVector<TilePattern*>> grid = QVector<QVector<TilePattern*>>(width, QVector<TilePattern*>(height));
+    PatternGrid grid = PatternGrid(width, height);
 
-    for(int x = 0; x < width; x++)
+    QMap<int,TilePattern>::const_iterator iter;
+    for(iter = patterns.constBegin(); iter != patterns.constEnd(); iter++)
     {
-        for(int y = 0; y < height; y++)
-        {
-            grid[x][y] = new TilePattern();
-        }
-    }
+        int x = iter.value().x/tileSize;
+        int y = iter.value().y/tileSize;
 
-    for(TilePattern* pattern : list)
-    {
-        grid[pattern->x/tileSize][pattern->y/tileSize] = pattern;
+        if(x >= 0 && y >= 0 && x < width && y < height)
+            grid.setId(x, y, iter.key());
     }
 
     return grid;
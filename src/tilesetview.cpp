@@ -1,4 +1,5 @@
 #include "tilesetview.h"
+#include "editcommands.h"
 
 TilesetView::TilesetView(QObject *parent) :
     QGraphicsScene(parent)
@@ -9,16 +10,20 @@ TilesetView::TilesetView(QObject *parent) :
     rightMouseDown = false;
 
     selectedTile = new QGraphicsRectItem(QRect(0, 0, 16, 16));
-    blockedMarkers = QVector<QVector<QGraphicsRectItem*>>();
+    selectedTile->setZValue(1);
+    selectedTileShown = false;
+
+    undoStack = nullptr;
+    dragId = 0;
+    tileset = nullptr;
 
     blockedBrush = QBrush(QColor(255, 0, 0));
 }
 
 TilesetView::~TilesetView()
 {
-    if(!items().contains(selectedTile) && selectedTile)
+    if(!selectedTileShown) // Otherwise owned (and deleted) by the scene
         delete selectedTile;
-    blockedMarkers.clear();
 }
 
 QPoint TilesetView::getMouseTilePos(QPointF scenePos)
@@ -26,27 +31,59 @@ QPoint TilesetView::getMouseTilePos(QPointF scenePos)
     return QPoint(scenePos.x() / tileset->getTileSize(), scenePos.y() / tileset->getTileSize());
 }
 
+QRectF TilesetView::getBlockedMarkerRect(const TilePattern* pattern) const
+{
+    return QRectF(pattern->x + pattern->width/4, pattern->y + pattern->height/4, pattern->width/2, pattern->height/2);
+}
+
 void TilesetView::enableBlocked(int x, int y)
 {
-    if(patterns[x][y]->traversable)
+    TilePattern* pattern = getPattern(x, y);
+    if(pattern && pattern->traversable)
     {
-        TilePattern* pattern = patterns[x][y];
         pattern->traversable = false;
-        blockedMarkers[x][y] = new QGraphicsRectItem(QRect(pattern->x + pattern->width/4, pattern->y + pattern->height/4,
-                                                           pattern->width/2, pattern->height/2));
-        blockedMarkers[x][y]->setBrush(blockedBrush);
-        addItem(blockedMarkers[x][y]);
+        update(getBlockedMarkerRect(pattern));
+
+        if(undoStack)
+            undoStack->push(new PatternToggleCommand(tileset, pattern->id, true, dragId));
     }
 }
 
 void TilesetView::disableBlocked(int x, int y)
 {
-    if(!patterns[x][y]->traversable)
+    TilePattern* pattern = getPattern(x, y);
+    if(pattern && !pattern->traversable)
+    {
+        pattern->traversable = true;
+        update(getBlockedMarkerRect(pattern));
+
+        if(undoStack)
+            undoStack->push(new PatternToggleCommand(tileset, pattern->id, false, dragId));
+    }
+}
+
+void TilesetView::showSelectedTile(QPoint tilePos)
+{
+    if(selectedTileShown && tilePos == prevTilePos)
+        return;
+
+    int tileSize = tileset->getTileSize();
+    selectedTile->setRect(tilePos.x() * tileSize, tilePos.y() * tileSize, tileSize, tileSize);
+    prevTilePos = tilePos;
+
+    if(!selectedTileShown)
     {
-        patterns[x][y]->traversable = true;
-        removeItem(blockedMarkers[x][y]);
-        delete blockedMarkers[x][y];
-        blockedMarkers[x][y] = nullptr;
+        addItem(selectedTile);
+        selectedTileShown = true;
+    }
+}
+
+void TilesetView::hideSelectedTile()
+{
+    if(selectedTileShown)
+    {
+        removeItem(selectedTile);
+        selectedTileShown = false;
     }
 }
 
@@ -60,54 +97,80 @@ void TilesetView::mouseOutOfBounds()
     over = false;
     leftMouseDown = false;
     rightMouseDown = false;
-    if(items().contains(selectedTile))
-        removeItem(selectedTile);
+    hideSelectedTile();
 }
 
 void TilesetView::setTileset(Tileset* tileset)
 {
-    if(items().contains(selectedTile))
-    {
-        removeItem(selectedTile);
-        delete selectedTile;
-        selectedTile = new QGraphicsRectItem(QRect(0, 0, 16, 16));
-    }
-
+    hideSelectedTile(); // Keep the selection marker from being deleted with the rest of the scene
     clear();
-    blockedMarkers.clear();
 
     this->tileset = tileset;
     this->setSceneRect(QRect(0, 0, tileset->getImage().width(), tileset->getImage().height()));
     addPixmap(tileset->getImage());
 
     hasTileset = true;
-    patterns = tileset->getPatternGrid();
 
-    blockedMarkers = QVector<QVector<QGraphicsRectItem*>>(tileset->getWidth(), QVector<QGraphicsRectItem*>(tileset->getHeight()));
-
-    // Add initial blocked markers
-    for(int x = 0; x < tileset->getWidth(); x++)
+    // Patterns are looked up once here, so hovering and drawing never search the pattern store
+    PatternGrid grid = tileset->getPatternGrid();
+    QMap<int,TilePattern>* store = tileset->getPatterns();
+    patterns = QVector<TilePattern*>(grid.ids.size(), nullptr);
+    for(int i = 0; i < grid.ids.size(); i++)
     {
-        for(int y = 0; y < tileset->getHeight(); y++)
-        {
-            blockedMarkers[x][y] = nullptr;
-            TilePattern* pattern = patterns[x][y];
-            if(!patterns[x][y]->traversable)
-            {
-                blockedMarkers[x][y] = new QGraphicsRectItem(QRect(pattern->x + pattern->width/4, pattern->y + pattern->height/4,
-                                                                   pattern->width/2, pattern->height/2));
-                blockedMarkers[x][y]->setBrush(blockedBrush);
-                addItem(blockedMarkers[x][y]);
-            }
-        }
+        QMap<int,TilePattern>::iterator iter = store->find(grid.ids[i]);
+        if(iter != store->end())
+            patterns[i] = &iter.value();
     }
 }
 
+void TilesetView::clearTileset()
+{
+    mouseOutOfBounds(); // Also keeps the selection marker from being deleted with the rest of the scene
+    clear();
+    setSceneRect(QRectF());
+
+    tileset = nullptr;
+    hasTileset = false;
+    patterns.clear();
+}
+
 void TilesetView::drawBackground(QPainter *painter, const QRectF &rect)
 {
 
 }
 
+void TilesetView::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    if(!hasTileset)
+        return;
+
+    QRectF exposed = rect.intersected(sceneRect());
+    if(exposed.isEmpty())
+        return;
+
+    // Only visit the patterns overlapping the exposed area
+    int tileSize = tileset->getTileSize();
+    int firstX = qMax(0, static_cast<int>(exposed.left()) / tileSize);
+    int firstY = qMax(0, static_cast<int>(exposed.top()) / tileSize);
+    int lastX = qMin(tileset->getWidth() - 1, static_cast<int>(exposed.right()) / tileSize);
+    int lastY = qMin(tileset->getHeight() - 1, static_cast<int>(exposed.bottom()) / tileSize);
+
+    QVector<QRectF> markers;
+    for(int x = firstX; x <= lastX; x++)
+    {
+        for(int y = firstY; y <= lastY; y++)
+        {
+            TilePattern* pattern = getPattern(x, y);
+            if(pattern && !pattern->traversable)
+                markers.append(getBlockedMarkerRect(pattern));
+        }
+    }
+
+    painter->setPen(QPen(Qt::black, 0));
+    painter->setBrush(blockedBrush);
+    painter->drawRects(markers.constData(), markers.size());
+}
+
 void TilesetView::mouseMoveEvent(QGraphicsSceneMouseEvent * mouseEvent)
 {
     // Check for mouse movements on the scene
@@ -118,12 +181,7 @@ void TilesetView::mouseMoveEvent(QGraphicsSceneMouseEvent * mouseEvent)
         if(isInBounds(tilePos))
         {
             over = true;
-            selectedTile->setRect(tilePos.x() * tileset->getTileSize(), tilePos.y() * tileset->getTileSize(),
-                                      tileset->getTileSize(), tileset->getTileSize());
-            selectedTile->setZValue(1);
-
-            if(!items().contains(selectedTile))
-                addItem(selectedTile);
+            showSelectedTile(tilePos);
         }
         else
             mouseOutOfBounds();
@@ -147,14 +205,14 @@ void TilesetView::mouseMoveEvent(QGraphicsSceneMouseEvent * mouseEvent)
                 mouseOutOfBounds();
         }
     }
-
-    this->update();
 }
 
 void TilesetView::mousePressEvent(QGraphicsSceneMouseEvent *event)
 {
     if(over)
     {
+        dragId++;
+
         if(event->button() == Qt::LeftButton)
             leftMouseDown = true;
         if(event->button() == Qt::RightButton)
@@ -167,8 +225,6 @@ void TilesetView::mousePressEvent(QGraphicsSceneMouseEvent *event)
         enableBlocked(currentTilePos.x(), currentTilePos.y());
     else if(over && rightMouseDown)
         disableBlocked(currentTilePos.x(), currentTilePos.y());
-
-    this->update();
 }
 
 void TilesetView::dragMoveEvent(QGraphicsSceneDragDropEvent *event)
@@ -182,8 +238,6 @@ void TilesetView::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
         leftMouseDown = false;
     if(event->button() == Qt::RightButton)
         rightMouseDown = false;
-
-    this->update();
 }
 
 
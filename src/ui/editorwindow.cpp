@@ -1,6 +1,8 @@
 #include "editorwindow.h"
 #include "ui_editorwindow.h"
 
+#include <QInputDialog>
+
 
 EditorWindow::EditorWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -17,6 +19,8 @@ EditorWindow::EditorWindow(QWidget *parent) :
     questOnlyActions.append(ui->actionNew_Script);
     questOnlyActions.append(ui->actionNew_Tileset);
     questOnlyActions.append(ui->actionQuest_Database);
+    questOnlyActions.append(ui->actionValidate_Quest);
+    questOnlyActions.append(ui->actionGenerate_World);
     questOnlyActions.append(ui->actionRun);
 
     questOnlyWidgets = QList<QWidget*>();
@@ -27,6 +31,45 @@ EditorWindow::EditorWindow(QWidget *parent) :
     keyEventModel = nullptr;
     gateModel = nullptr;
     runningGame = nullptr;
+    questWatcher = nullptr;
+    questLoader = nullptr;
+    questValidator = nullptr;
+
+    // Compile list of actions that need every map and tileset of the quest
+    fullQuestActions = QList<QAction*>();
+    fullQuestActions.append(ui->actionNew_Map);
+    fullQuestActions.append(ui->actionQuest_Database);
+    fullQuestActions.append(ui->actionValidate_Quest);
+    fullQuestActions.append(ui->actionGenerate_World);
+    fullQuestActions.append(ui->actionRun);
+
+    // Load progress is shown in the status bar while a quest is opening
+    loadProgress = new QProgressBar(this);
+    loadProgress->setMaximumWidth(200);
+    cancelLoadButton = new QPushButton("Cancel", this);
+    ui->statusbar->addPermanentWidget(loadProgress);
+    ui->statusbar->addPermanentWidget(cancelLoadButton);
+    loadProgress->hide();
+    cancelLoadButton->hide();
+
+    // Validation issues are listed in a dock, shown the first time a quest is validated
+    issuesList = new QTreeWidget(this);
+    issuesList->setHeaderLabels(QStringList() << "Severity" << "File" << "Tile" << "Message");
+    issuesList->setRootIsDecorated(false);
+    issuesList->setSortingEnabled(true);
+    connect(issuesList, SIGNAL(itemActivated(QTreeWidgetItem*,int)), this, SLOT(issueActivated(QTreeWidgetItem*)));
+    issuesDock = new QDockWidget("Issues", this);
+    issuesDock->setWidget(issuesList);
+    addDockWidget(Qt::BottomDockWidgetArea, issuesDock);
+    issuesDock->hide();
+    ui->menuTools->addAction(issuesDock->toggleViewAction());
+
+    undoStack = new UndoStack(this);
+    connect(undoStack, SIGNAL(canUndoChanged(bool)), ui->actionUndo, SLOT(setEnabled(bool)));
+    connect(undoStack, SIGNAL(canRedoChanged(bool)), ui->actionRedo, SLOT(setEnabled(bool)));
+
+    mapScene = new MapView(this);
+    ui->mapGraphicsView->setScene(mapScene);
 
     setWindowTitle("ProcLevelDesigner");
 
@@ -78,6 +121,27 @@ void EditorWindow::on_actionSave_Quest_triggered()
 
 void EditorWindow::on_actionClose_triggered()
 {
+    mapScene->clearMap();
+    ui->mapSelector->clear();
+
+    undoStack->clear();
+    if(questValidator)
+    {
+        delete questValidator;
+        questValidator = nullptr;
+    }
+    issuesList->clear();
+    if(questLoader)
+    {
+        delete questLoader;
+        questLoader = nullptr;
+        setQuestLoadingUI(false);
+    }
+    if(questWatcher)
+    {
+        delete questWatcher;
+        questWatcher = nullptr;
+    }
     quest.clear();
 
     setQuestOnlyUIEnabled(false);
@@ -119,15 +183,22 @@ void EditorWindow::on_actionOpen_Quest_triggered()
     {
         quest = Quest(dialog->getFolderPath() + QDir::separator() + "data" + QDir::separator());
 
-        if(quest.Init()) // Attempt to initialize quest from the given path
+        if(quest.initHeader()) // Attempt to initialize quest from the given path
         {
             // Populate the trees and set window title
             setWindowTitle("ProcLevelDesigner - " + quest.getName());
 
-            // Initialize the UI with quest data
+            // Initialize the UI with quest data. Maps are added to it as they finish loading.
             initQuestUI();
-
             setQuestOnlyUIEnabled(true);
+            setQuestLoadingUI(true);
+
+            questLoader = new QuestLoader(&quest, this);
+            connect(questLoader, SIGNAL(progressChanged(int,int)), this, SLOT(questLoadProgress(int,int)));
+            connect(questLoader, SIGNAL(mapLoaded(QString)), this, SLOT(questMapLoaded(QString)));
+            connect(questLoader, SIGNAL(finished(bool)), this, SLOT(questLoadFinished(bool)));
+            connect(cancelLoadButton, SIGNAL(clicked()), questLoader, SLOT(cancel()));
+            questLoader->start();
         }
         else
             QMessageBox::warning(this, "Error", "No valid quest was found in this folder.", QMessageBox::Ok);
@@ -176,10 +247,82 @@ void EditorWindow::on_actionNew_Quest_triggered()
 
 void EditorWindow::on_actionQuest_Database_triggered()
 {
-    QuestDatabase* dialog = new QuestDatabase(&quest, this);
+    QuestDatabase* dialog = new QuestDatabase(&quest, undoStack, this);
+    if(questWatcher)
+        connect(questWatcher, SIGNAL(tilesetReloaded(QString)), dialog, SLOT(tilesetReloaded(QString)));
     dialog->exec();
     setWindowTitle("ProcLevelDesigner - " + quest.getData(DAT_QUEST)->getElementValue(OBJ_QUEST, ELE_TITLE_BAR));
     delete dialog;
+
+    // Merging tilesets may have moved the current map over to a new tileset
+    on_mapSelector_currentIndexChanged(ui->mapSelector->currentIndex());
+}
+
+void EditorWindow::on_actionValidate_Quest_triggered()
+{
+    if(questValidator)
+        delete questValidator; // Cancels the previous validation, its issues are listed again
+
+    issuesList->clear();
+    issuesDock->show();
+
+    questValidator = new QuestValidator(&quest, this);
+    connect(questValidator, SIGNAL(issuesFound(QList<ValidationIssue>)), this, SLOT(questIssuesFound(QList<ValidationIssue>)));
+    connect(questValidator, SIGNAL(finished(bool)), this, SLOT(questValidationFinished(bool)));
+    questValidator->start();
+
+    ui->statusbar->showMessage("Validating quest...");
+}
+
+void EditorWindow::on_actionGenerate_World_triggered()
+{
+    QStringList tilesets = quest.getTilesets()->keys();
+    if(tilesets.isEmpty())
+    {
+        QMessageBox::warning(this, "Error", "Cannot generate a world, the quest has no tilesets.", QMessageBox::Ok);
+        return;
+    }
+
+    bool ok;
+    WorldSettings settings;
+    settings.tileset = QInputDialog::getItem(this, "Generate World", "Tileset:", tilesets, 0, false, &ok);
+    if(!ok)
+        return;
+    settings.mapCount = QInputDialog::getInt(this, "Generate World", "Number of maps:", 1, 1, 1000, 1, &ok);
+    if(!ok)
+        return;
+    settings.prefix = QInputDialog::getText(this, "Generate World", "Map name prefix:", QLineEdit::Normal, "world", &ok).replace(' ', '_');
+    if(!ok)
+        return;
+    settings.seed = static_cast<uint>(QDateTime::currentMSecsSinceEpoch());
+
+    QVector<qreal> backtracking;
+    QStringList names = quest.generateWorld(settings, &backtracking);
+    if(names.isEmpty())
+    {
+        QMessageBox::warning(this, "Error", "Cannot generate a world. The tileset needs a walkable pattern, no map may "
+                             "already use the chosen prefix, and the maps need room for every key event.", QMessageBox::Ok);
+        return;
+    }
+
+    for(const QString& name : names)
+        ui->mapSelector->addItem(name);
+
+    // Maps where part of the route cannot be reached are reported apart from the distance walked back
+    qreal walkedBack = 0.0;
+    int unreachable = 0;
+    for(qreal tiles : backtracking)
+    {
+        if(tiles < 0.0)
+            unreachable++;
+        else
+            walkedBack += tiles;
+    }
+
+    QString message = QString("Generated %1 map(s), %2 tiles of backtracking").arg(names.size()).arg(walkedBack, 0, 'f', 1);
+    if(unreachable > 0)
+        message += QString(", %1 map(s) with unreachable keys or gates").arg(unreachable);
+    ui->statusbar->showMessage(message, 5000);
 }
 
 void EditorWindow::on_actionRun_triggered()
@@ -205,6 +348,20 @@ void EditorWindow::on_actionSet_Solarus_Directory_triggered()
     delete dialog;
 }
 
+void EditorWindow::on_actionUndo_triggered()
+{
+    undoStack->undo();
+    updateKeyList();
+    updateGateList();
+}
+
+void EditorWindow::on_actionRedo_triggered()
+{
+    undoStack->redo();
+    updateKeyList();
+    updateGateList();
+}
+
 /* ------------------------------------------------------------------
  *  KEY BUTTON ACTIONS
  * ------------------------------------------------------------------*/
@@ -214,8 +371,14 @@ void EditorWindow::on_newKeyEventButton_clicked()
     if(dialog->exec() == QDialog::Accepted)
     {
         MissionItemCollection* items = quest.mission.getItems();
-        items->AddKeyEvent(dialog->getName(), Key(dialog->getName(), dialog->getType(), dialog->getMessage()));
-        updateKeyList();
+        Key key = Key(dialog->getName(), dialog->getType(), dialog->getMessage());
+        if(items->AddKeyEvent(key.getName(), key))
+        {
+            undoStack->push(new KeyEventCommand(items, KeyEventCommand::Add, Key(), key));
+            appendListRow(keyEventModel, key.getName());
+        }
+        else
+            QMessageBox::warning(this, "Error", "Could not add key, a key with that name already exists.", QMessageBox::Ok);
     }
     delete dialog;
 }
@@ -224,16 +387,25 @@ void EditorWindow::on_newKeyEventButton_clicked()
 void EditorWindow::on_editKeyEventButton_clicked()
 {
     Key* editKey = getSelectedKey();
+    int row = ui->keyEventList->currentIndex().row();
 
     if(editKey != nullptr)
     {
         EditKeyEvent* dialog = new EditKeyEvent(editKey, this);
         if(dialog->exec() == QDialog::Accepted)
         {
-            editKey->setName(dialog->getName());
-            editKey->setType(dialog->getType());
-            editKey->setMessage(dialog->getMessage());
-            updateKeyList();
+            MissionItemCollection* items = quest.mission.getItems();
+            Key oldKey = *editKey;
+            Key newKey = Key(dialog->getName(), dialog->getType(), dialog->getMessage());
+
+            // Renaming the key also renames it in every gate that needs it
+            if(items->ReplaceKeyEvent(oldKey.getName(), newKey))
+            {
+                undoStack->push(new KeyEventCommand(items, KeyEventCommand::Edit, oldKey, newKey));
+                keyEventModel->setData(keyEventModel->index(row), newKey.getName());
+            }
+            else
+                QMessageBox::warning(this, "Error", "Could not edit key, a key with that name already exists.", QMessageBox::Ok);
         }
 
         delete dialog;
@@ -245,16 +417,21 @@ void EditorWindow::on_editKeyEventButton_clicked()
 void EditorWindow::on_removeKeyEventButton_clicked()
 {
     Key* removeKey = getSelectedKey();
+    int row = ui->keyEventList->currentIndex().row();
 
     if(removeKey != nullptr)
     {
         if(QMessageBox::question(this, "Removing Key Event", "Are you sure you wish to remove this key event from the mission?",
                                  QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes)
         {
-            if(!quest.mission.getItems()->RemoveKeyEvent(removeKey->getName()))
+            Key removed = *removeKey;
+            if(!quest.mission.getItems()->RemoveKeyEvent(removed.getName()))
                 QMessageBox::warning(this, "Error", "Could not remove key, not found in item collection!", QMessageBox::Ok);
             else
-                updateKeyList();
+            {
+                undoStack->push(new KeyEventCommand(quest.mission.getItems(), KeyEventCommand::Remove, removed, Key()));
+                keyEventModel->removeRow(row);
+            }
         }
     }
     else
@@ -266,9 +443,15 @@ void EditorWindow::on_newGateButton_clicked()
     EditGateDialog* dialog = new EditGateDialog(quest.mission.getItems()->getKeyEventNameList(), this);
     if(dialog->exec() == QDialog::Accepted)
     {
-        quest.mission.getItems()->AddGate(dialog->getName(),
-                                          Gate(dialog->getName(), dialog->getType(), dialog->getKeys(), dialog->isTriggered()));
-        updateGateList();
+        MissionItemCollection* items = quest.mission.getItems();
+        Gate gate = Gate(dialog->getName(), dialog->getType(), dialog->getKeys(), dialog->isTriggered());
+        if(items->AddGate(gate.getName(), gate))
+        {
+            undoStack->push(new GateCommand(items, GateCommand::Add, Gate(), gate));
+            appendListRow(gateModel, gate.getName());
+        }
+        else
+            QMessageBox::warning(this, "Error", "Could not add gate, a gate with that name already exists.", QMessageBox::Ok);
     }
     delete dialog;
 }
@@ -276,6 +459,7 @@ void EditorWindow::on_newGateButton_clicked()
 void EditorWindow::on_editGateButton_clicked()
 {
     QVariant selected = ui->gateList->currentIndex().data();
+    int row = ui->gateList->currentIndex().row();
     if(!selected.isNull())
     {
         Gate* selectedGate = quest.mission.getItems()->getGate(selected.toString());
@@ -284,12 +468,17 @@ void EditorWindow::on_editGateButton_clicked()
             EditGateDialog* dialog = new EditGateDialog(selectedGate, quest.mission.getItems()->getKeyEventNameList(), this);
             if(dialog->exec() == QDialog::Accepted)
             {
-                selectedGate->setKeys(dialog->getKeys());
-                selectedGate->setName(dialog->getName());
-                selectedGate->setTriggered(dialog->isTriggered());
-                selectedGate->setType(dialog->getType());
-
-                updateGateList();
+                MissionItemCollection* items = quest.mission.getItems();
+                Gate oldGate = *selectedGate;
+                Gate newGate = Gate(dialog->getName(), dialog->getType(), dialog->getKeys(), dialog->isTriggered());
+
+                if(items->ReplaceGate(oldGate.getName(), newGate))
+                {
+                    undoStack->push(new GateCommand(items, GateCommand::Edit, oldGate, newGate));
+                    gateModel->setData(gateModel->index(row), newGate.getName());
+                }
+                else
+                    QMessageBox::warning(this, "Error", "Could not edit gate, a gate with that name already exists.", QMessageBox::Ok);
             }
             delete dialog;
         }
@@ -305,22 +494,164 @@ void EditorWindow::on_editGateButton_clicked()
 void EditorWindow::on_removeGateButton_clicked()
 {
     Gate* removeGate = getSelectedGate();
+    int row = ui->gateList->currentIndex().row();
 
     if(removeGate != nullptr)
     {
         if(QMessageBox::question(this, "Removing Gate", "Are you sure you wish to remove this gate from the mission?",
                                  QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes)
         {
-            if(!quest.mission.getItems()->RemoveGate(removeGate->getName()))
+            Gate removed = *removeGate;
+            if(!quest.mission.getItems()->RemoveGate(removed.getName()))
                 QMessageBox::warning(this, "Error", "Could not remove gate, not found in item collection!", QMessageBox::Ok);
             else
-                updateGateList();
+            {
+                undoStack->push(new GateCommand(quest.mission.getItems(), GateCommand::Remove, removed, Gate()));
+                gateModel->removeRow(row);
+            }
         }
     }
     else
         QMessageBox::warning(this, "Error", "Cannot remove gate, no gate selected.", QMessageBox::Ok);
 }
 
+/* ------------------------------------------------------------------
+ *  SPACE TAB
+ * ------------------------------------------------------------------*/
+void EditorWindow::on_mapSelector_currentIndexChanged(int index)
+{
+    if(index < 0)
+        mapScene->clearMap();
+    else
+        mapScene->setMap(quest.getMap(ui->mapSelector->itemText(index)));
+}
+
+/* ------------------------------------------------------------------
+ *  QUEST LOADING
+ * ------------------------------------------------------------------*/
+void EditorWindow::questLoadProgress(int loaded, int total)
+{
+    loadProgress->setRange(0, total);
+    loadProgress->setValue(loaded);
+}
+
+void EditorWindow::questMapLoaded(QString name)
+{
+    ui->mapSelector->addItem(name);
+}
+
+void EditorWindow::questLoadFinished(bool cancelled)
+{
+    questLoader->deleteLater();
+    questLoader = nullptr;
+    setQuestLoadingUI(false);
+
+    if(cancelled)
+    {
+        ui->actionClose->trigger();
+        return;
+    }
+
+    // Pick up changes made to the quest's data by other tools
+    questWatcher = new QuestWatcher(&quest, this);
+    questWatcher->watchLoadedData();
+    connect(questWatcher, SIGNAL(dataReloaded(QString)), this, SLOT(questDataReloaded(QString)));
+    connect(questWatcher, SIGNAL(tilesetReloaded(QString)), this, SLOT(questTilesetReloaded(QString)));
+    connect(questWatcher, SIGNAL(missionReloaded()), this, SLOT(questMissionReloaded()));
+    connect(questWatcher, SIGNAL(conflictDetected(QStringList)), this, SLOT(questDataConflict(QStringList)));
+}
+
+/* ------------------------------------------------------------------
+ *  EXTERNAL CHANGES
+ * ------------------------------------------------------------------*/
+void EditorWindow::questDataReloaded(QString filePath)
+{
+    undoStack->clear(); // Recorded edits may refer to data that no longer exists
+    ui->statusbar->showMessage("Reloaded " + filePath + DAT_EXT, 5000);
+}
+
+void EditorWindow::questTilesetReloaded(QString name)
+{
+    // The map scene caches the tileset image, so it is set up again if it shows a map using the tileset
+    QMap<QString,Map>::iterator map = quest.getMaps()->find(ui->mapSelector->currentText());
+    if(map == quest.getMaps()->end())
+        return;
+
+    Tileset* tileset = map.value().getTileSet();
+    if(tileset != nullptr && tileset->getName() == name)
+        mapScene->setMap(&map.value());
+}
+
+void EditorWindow::questMissionReloaded()
+{
+    updateKeyList();
+    updateGateList();
+}
+
+void EditorWindow::questDataConflict(QStringList filePaths)
+{
+    int result = QMessageBox::question(this, "Files Changed",
+                                       "The following files were changed outside the editor, but also have unsaved changes:\n\n" +
+                                       filePaths.join("\n") + "\n\nReload them and discard your changes?",
+                                       QMessageBox::Yes | QMessageBox::No);
+
+    if(result == QMessageBox::Yes)
+        questWatcher->reload(filePaths);
+}
+
+/* ------------------------------------------------------------------
+ *  VALIDATION
+ * ------------------------------------------------------------------*/
+void EditorWindow::questIssuesFound(QList<ValidationIssue> issues)
+{
+    issuesList->setSortingEnabled(false);
+    for(const ValidationIssue& issue : issues)
+    {
+        QTreeWidgetItem* item = new QTreeWidgetItem(issuesList);
+        item->setText(0, issue.severity == ValidationIssue::Error ? "Error" : "Warning");
+        item->setText(1, issue.filePath + DAT_EXT);
+        if(issue.tile.x() >= 0)
+            item->setText(2, QString("%1, %2").arg(issue.tile.x()).arg(issue.tile.y()));
+        item->setText(3, issue.message);
+        item->setData(0, Qt::UserRole, issue.filePath);
+        item->setData(0, Qt::UserRole + 1, issue.tile);
+    }
+    issuesList->setSortingEnabled(true);
+}
+
+void EditorWindow::questValidationFinished(bool cancelled)
+{
+    questValidator->deleteLater();
+    questValidator = nullptr;
+
+    if(cancelled)
+        ui->statusbar->showMessage("Validation cancelled", 5000);
+    else if(issuesList->topLevelItemCount() == 0)
+        ui->statusbar->showMessage("No issues found", 5000);
+    else
+        ui->statusbar->showMessage(QString("%1 issue(s) found").arg(issuesList->topLevelItemCount()), 5000);
+}
+
+void EditorWindow::issueActivated(QTreeWidgetItem* item)
+{
+    // Map issues open the map, centered on the offending tile if there is one
+    QString filePath = item->data(0, Qt::UserRole).toString();
+    if(filePath.section(QDir::separator(), 0, 0) != "maps")
+        return;
+
+    int index = ui->mapSelector->findText(filePath.section(QDir::separator(), 1));
+    if(index < 0)
+        return;
+
+    ui->tabView->setCurrentWidget(ui->spaceTab);
+    ui->mapSelector->setCurrentIndex(index);
+
+    QPoint tile = item->data(0, Qt::UserRole + 1).toPoint();
+    Map* map = quest.getMap(ui->mapSelector->itemText(index));
+    if(tile.x() >= 0 && map != nullptr)
+        ui->mapGraphicsView->centerOn((tile.x() + 0.5) * map->getTileSize(), (tile.y() + 0.5) * map->getTileSize());
+}
+
 /* ------------------------------------------------------------------
  *  HELPER FUNCTIONS
  * ------------------------------------------------------------------*/
@@ -347,6 +678,15 @@ void EditorWindow::setQuestOnlyUIEnabled(bool enabled)
 
 }
 
+void EditorWindow::setQuestLoadingUI(bool loading)
+{
+    for(QAction* action : fullQuestActions)
+        action->setEnabled(!loading);
+
+    loadProgress->setVisible(loading);
+    cancelLoadButton->setVisible(loading);
+}
+
 void EditorWindow::initQuestUI()
 {
     // Initialize and clear models
@@ -374,28 +714,29 @@ void EditorWindow::initQuestUI()
     // Disable edit triggers for views
     ui->keyEventList->setEditTriggers(QAbstractItemView::NoEditTriggers);
     ui->gateList->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    // Fill the map selector, which displays the first map
+    ui->mapSelector->clear();
+    ui->mapSelector->addItems(quest.getMaps()->keys());
 }
 
 void EditorWindow::updateKeyList()
 {
-    keyData.clear();
-    QList<Key*> keys = quest.mission.getItems()->getKeyEventList();
-    for(Key* key : keys)
-        keyData.append(key->getName());
+    keyData = quest.mission.getItems()->getKeyEventNameList();
     keyEventModel->setStringList(keyData);
-
-    quest.mission.getItems()->Build(quest.getData(DAT_MISSION_ITEMS));
 }
 
 void EditorWindow::updateGateList()
 {
-    gateData.clear();
-    QList<Gate*> gates = quest.mission.getItems()->getGateList();
-    for(Gate* gate : gates)
-        gateData.append(gate->getName());
+    gateData = quest.mission.getItems()->getGateNameList();
     gateModel->setStringList(gateData);
+}
 
-    quest.mission.getItems()->Build(quest.getData(DAT_MISSION_ITEMS));
+void EditorWindow::appendListRow(QStringListModel* model, QString text)
+{
+    int row = model->rowCount();
+    model->insertRow(row);
+    model->setData(model->index(row), text);
 }
 
 
@@ -408,7 +749,7 @@ Key* EditorWindow::getSelectedKey()
 
 Gate* EditorWindow::getSelectedGate()
 {
-    QVariant selectedGateID = ui->keyEventList->currentIndex().data();
+    QVariant selectedGateID = ui->gateList->currentIndex().data();
     QString gateName = selectedGateID.toString();
     return quest.mission.getItems()->getGate(gateName);
 }
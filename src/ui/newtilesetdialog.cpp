@@ -7,6 +7,7 @@ NewTilesetDialog::NewTilesetDialog(QWidget *parent) :
 {
     ui->setupUi(this);
     scene = new QGraphicsScene();
+    deduplicate = false;
 }
 
 NewTilesetDialog::~NewTilesetDialog()
@@ -23,6 +24,7 @@ void NewTilesetDialog::on_buttonOK_clicked()
         name = ui->nameEdit->text();
         filePath = ui->fileEdit->text();
         tileSize = ui->tilesizeEdit->value();
+        deduplicate = ui->deduplicateCheckBox->isChecked();
         accept();
     }
     else
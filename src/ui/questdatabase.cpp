@@ -1,7 +1,9 @@
 #include "questdatabase.h"
 #include "ui_questdatabase.h"
 
-QuestDatabase::QuestDatabase(Quest* quest, QWidget *parent) :
+#include <QInputDialog>
+
+QuestDatabase::QuestDatabase(Quest* quest, UndoStack* undoStack, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::QuestDatabase)
 {
@@ -10,6 +12,18 @@ QuestDatabase::QuestDatabase(Quest* quest, QWidget *parent) :
     setMouseTracking(true);
 
     this->quest = quest;
+    this->undoStack = undoStack;
+
+    // Undo and redo shortcuts (the main window's actions are unreachable while this dialog is open)
+    QAction* undoAction = new QAction(this);
+    undoAction->setShortcut(QKeySequence::Undo);
+    connect(undoAction, SIGNAL(triggered()), this, SLOT(undo()));
+    addAction(undoAction);
+
+    QAction* redoAction = new QAction(this);
+    redoAction->setShortcut(QKeySequence::Redo);
+    connect(redoAction, SIGNAL(triggered()), this, SLOT(redo()));
+    addAction(redoAction);
 
     setWindowTitle("Quest Database - " + quest->getName());
 
@@ -29,6 +43,7 @@ void QuestDatabase::initTilesetTab()
     selectedTileset = nullptr;
     openTileSets = QList<Tileset*>();
     tilesetScene = new TilesetView(this);
+    tilesetScene->setUndoStack(undoStack);
     tilesetModel = new QStandardItemModel();
 
     // UI Initialization
@@ -86,7 +101,9 @@ void QuestDatabase::on_addTilesetButton_clicked()
 
         // Create a new .dat file
         Table* data = quest->getData(QString("tilesets") + QDir::separator() + dialog->getName());
-        Tileset set = Tileset::create(dialog->getName(), dialog->getFilePath(), data, dialog->getTileSize());
+        Tileset set = Tileset::create(dialog->getName(), dialog->getFilePath(), data, dialog->getTileSize(),
+                                      dialog->isDeduplicated());
+        set.setThumbnail(ThumbnailCache::load(dialog->getFilePath()));
         quest->addTileSet(set);
         updateTilesetModel();
     }
@@ -102,22 +119,145 @@ void QuestDatabase::updateTilesetModel()
 
     tilesetModel->setRowCount(list.length());
     for(int i = 0; i < list.length(); i++)
-        tilesetModel->setItem(i, new QStandardItem(list[i]->getName()));
+    {
+        // Tilesets are listed with their cached thumbnail, the full images are only decoded once opened
+        QImage thumbnail = list[i]->getThumbnail();
+        if(thumbnail.isNull())
+            tilesetModel->setItem(i, new QStandardItem(list[i]->getName()));
+        else
+            tilesetModel->setItem(i, new QStandardItem(QIcon(QPixmap::fromImage(thumbnail)), list[i]->getName()));
+    }
 }
 
 void QuestDatabase::on_removeTilesetButton_clicked()
 {
+    if(selectedTileset == nullptr)
+        return;
+
+    // Maps are looked up through the quest's index, rather than by reading every map
+    QStringList maps = quest->getIndex()->getMapsUsingTileset(selectedTileset->getName());
+    QString usage = maps.isEmpty() ? QString() : " It is used by the maps " + maps.join(", ") + ".";
+
     if(QMessageBox::warning(this, "Warning", "Removing tileset " + selectedTileset->getName() +
-                         " will delete all local .dat and image files. Are you sure you wish to do this?", QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes)
+                         " will delete all local .dat and image files." + usage + " Are you sure you wish to do this?", QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes)
     {
         Tileset* set = quest->getTileset(selectedTileset->getName());
         openTileSets.removeOne(set);
+
+        // Nothing may keep pointing at the tileset once it is deleted, including the edits recorded on it
+        tilesetScene->clearTileset();
+        selectedTileset = nullptr;
+        ui->setLabel->setEnabled(false);
+        ui->setLabel->setText("Current Tileset:");
+        undoStack->clear();
+
         quest->removeTileset(set->getName());
 
         updateTilesetModel();
     }
 }
 
+void QuestDatabase::on_mergeTilesetsButton_clicked()
+{
+    QStringList names;
+    for(const QModelIndex& index : ui->tilesetsList->selectionModel()->selectedIndexes())
+        names.append(index.data().toString());
+
+    if(names.size() < 2)
+    {
+        QMessageBox::information(this, "Merge Tilesets", "Select at least two tilesets to merge.", QMessageBox::Ok);
+        return;
+    }
+
+    QString name = QInputDialog::getText(this, "Merge Tilesets", "Name of the merged tileset:").replace(' ', '_');
+    if(name.isEmpty())
+        return;
+
+    if(quest->getTilesets()->contains(name))
+    {
+        QMessageBox::warning(this, "Error", "A tileset named " + name + " already exists.", QMessageBox::Ok);
+        return;
+    }
+
+    if(!quest->mergeTilesets(names, name))
+    {
+        QMessageBox::warning(this, "Error", "The selected tilesets could not be merged. All of them must use the same tile size, "
+                             "and the files of the new tileset must not exist yet and be writable.",
+                             QMessageBox::Ok);
+        return;
+    }
+
+    // Map edits made before the merge refer to the old pattern IDs
+    undoStack->clear();
+    updateTilesetModel();
+
+    QMessageBox::information(this, "Merge Tilesets", "Created tileset " + name + " from " + names.join(", ") +
+                             ". Maps using the merged tilesets now use " + name + ".", QMessageBox::Ok);
+}
+
+void QuestDatabase::on_pruneTilesetsButton_clicked()
+{
+    QStringList names;
+    for(const QModelIndex& index : ui->tilesetsList->selectionModel()->selectedIndexes())
+        names.append(index.data().toString());
+
+    if(names.isEmpty())
+    {
+        QMessageBox::information(this, "Prune Tilesets", "Select the tilesets to prune.", QMessageBox::Ok);
+        return;
+    }
+
+    // Count the unused patterns of each tileset first, so the user knows what will be removed
+    QStringList summary;
+    int unusedTotal = 0;
+    for(const QString& name : names)
+    {
+        Tileset* tileset = quest->getTileset(name);
+        if(tileset == nullptr)
+            continue;
+
+        QHash<int,int> usage = quest->getPatternUsage(name);
+        int unused = 0;
+        for(int id : tileset->getPatterns()->keys())
+        {
+            if(!usage.contains(id))
+                unused++;
+        }
+
+        summary.append(name + ": " + QString::number(unused) + " of " + QString::number(tileset->getPatterns()->size()) +
+                       " patterns unused");
+        unusedTotal += unused;
+    }
+
+    if(unusedTotal == 0)
+    {
+        QMessageBox::information(this, "Prune Tilesets", "Every pattern of the selected tilesets is used.\n\n" +
+                                 summary.join("\n"), QMessageBox::Ok);
+        return;
+    }
+
+    if(QMessageBox::question(this, "Prune Tilesets", summary.join("\n") + "\n\nRemove the unused patterns? The remaining "
+                             "patterns are renumbered, and the maps using them updated.",
+                             QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes)
+        return;
+
+    for(const QString& name : names)
+        quest->prunePatterns(name);
+
+    // Map edits made before pruning refer to the old pattern IDs
+    undoStack->clear();
+    updateTilesetModel();
+
+    if(selectedTileset)
+        tilesetScene->setTileset(selectedTileset);
+}
+
+void QuestDatabase::tilesetReloaded(QString name)
+{
+    if(selectedTileset && selectedTileset->getName() == name)
+        tilesetScene->setTileset(selectedTileset);
+}
+
 void QuestDatabase::on_OKButton_clicked()
 {
     // Validate all inputs here
@@ -130,7 +270,10 @@ void QuestDatabase::on_OKButton_clicked()
 
         // Save all opened tilesets (assumption is that all have been modified)
         for(Tileset* set : openTileSets)
+        {
             Tileset::build(*set);
+            set->saveToDisk();
+        }
 
         accept();
     }
@@ -153,6 +296,18 @@ void QuestDatabase::closeEvent(QCloseEvent* event)
         event->ignore();
 }
 
+void QuestDatabase::undo()
+{
+    undoStack->undo();
+    tilesetScene->update();
+}
+
+void QuestDatabase::redo()
+{
+    undoStack->redo();
+    tilesetScene->update();
+}
+
 bool QuestDatabase::validate()
 {
     return ui->questNameEdit->text().length() != 0;
@@ -0,0 +1,136 @@
+#include "undostack.h"
+
+UndoStack::UndoStack(QObject *parent) :
+    QObject(parent)
+{
+    index = 0;
+    memoryUsed = 0;
+    memoryLimit = DEFAULT_UNDO_MEMORY_LIMIT;
+}
+
+UndoStack::~UndoStack()
+{
+    qDeleteAll(commands);
+}
+
+void UndoStack::push(UndoCommand* command)
+{
+    bool couldUndo = canUndo(), couldRedo = canRedo();
+
+    // Discard everything that was undone
+    while(commands.size() > index)
+    {
+        memoryUsed -= costs.takeLast();
+        delete commands.takeLast();
+    }
+
+    // Attempt to merge with the previous command
+    if(index > 0 && command->id() != -1 && commands[index-1]->id() == command->id() &&
+       commands[index-1]->mergeWith(command))
+    {
+        delete command;
+
+        memoryUsed -= costs[index-1];
+        costs[index-1] = commands[index-1]->cost();
+        memoryUsed += costs[index-1];
+    }
+    else
+    {
+        commands.append(command);
+        costs.append(command->cost());
+        memoryUsed += costs.last();
+        index++;
+    }
+
+    trim();
+    notify(couldUndo, couldRedo);
+}
+
+void UndoStack::trim()
+{
+    while(memoryUsed > memoryLimit && commands.size() > 1)
+    {
+        memoryUsed -= costs.takeFirst();
+        delete commands.takeFirst();
+        index--;
+    }
+}
+
+bool UndoStack::canUndo() const
+{
+    return index > 0;
+}
+
+bool UndoStack::canRedo() const
+{
+    return index < commands.size();
+}
+
+QString UndoStack::getUndoText() const
+{
+    return canUndo() ? commands[index-1]->getText() : QString();
+}
+
+QString UndoStack::getRedoText() const
+{
+    return canRedo() ? commands[index]->getText() : QString();
+}
+
+void UndoStack::setMemoryLimit(qint64 bytes)
+{
+    bool couldUndo = canUndo(), couldRedo = canRedo();
+
+    memoryLimit = bytes;
+    trim();
+
+    notify(couldUndo, couldRedo);
+}
+
+void UndoStack::undo()
+{
+    if(!canUndo())
+        return;
+
+    bool couldRedo = canRedo();
+
+    index--;
+    commands[index]->undo();
+
+    notify(true, couldRedo);
+}
+
+void UndoStack::redo()
+{
+    if(!canRedo())
+        return;
+
+    bool couldUndo = canUndo();
+
+    commands[index]->redo();
+    index++;
+
+    notify(couldUndo, true);
+}
+
+void UndoStack::clear()
+{
+    bool couldUndo = canUndo(), couldRedo = canRedo();
+
+    qDeleteAll(commands);
+    commands.clear();
+    costs.clear();
+    index = 0;
+    memoryUsed = 0;
+
+    notify(couldUndo, couldRedo);
+}
+
+void UndoStack::notify(bool couldUndo, bool couldRedo)
+{
+    if(couldUndo != canUndo())
+        emit canUndoChanged(canUndo());
+    if(couldRedo != canRedo())
+        emit canRedoChanged(canRedo());
+
+    emit indexChanged(index);
+}
@@ -0,0 +1,401 @@
+#include "worldgenerator.h"
+#include "pathfinder.h"
+#include "profiler.h"
+
+#include <QtConcurrent>
+#include <QSet>
+#include <QQueue>
+#include <algorithm>
+#include <random>
+
+namespace
+{
+
+const QString DESTINATION_FROM_PREVIOUS = "from_previous"; /*!< Arrival point of the teletransporter from the previous map. */
+const QString DESTINATION_FROM_NEXT = "from_next";         /*!< Arrival point of the teletransporter from the next map. */
+
+/*!
+ * \brief Generates the tiles of a single map and places its keys and gates. Runs on a worker thread.
+ */
+WorldMap generateMap(const WorldMap& job)
+{
+    PROFILE_SCOPE("WorldGenerator::generateMap");
+
+    WorldMap result = job;
+    const WorldSettings& settings = job.settings;
+    int width = settings.width;
+    int height = settings.height;
+    int corridor = height / 2;
+
+    std::seed_seq seed{ settings.seed, static_cast<uint>(job.index) };
+    std::mt19937 random(seed);
+
+    QVector<bool> walls(width * height, false);
+    auto wall = [&](int x, int y) -> bool& { return walls[y * width + x]; };
+
+    // Border, open where the corridor leads to neighbouring maps
+    for(int x = 0; x < width; x++)
+        wall(x, 0) = wall(x, height - 1) = true;
+    for(int y = 0; y < height; y++)
+        wall(0, y) = wall(width - 1, y) = true;
+
+    if(job.entrance.x() >= 0)
+        wall(job.entrance.x(), job.entrance.y()) = false;
+    if(job.exit.x() >= 0)
+        wall(job.exit.x(), job.exit.y()) = false;
+
+    // One band per area. Bands behind a gate are walled off, except where the corridor crosses. The first band starts
+    // one tile in, leaving room for players to arrive in front of its gate.
+    int bandCount = qMax(1, job.areas.size());
+    int start = !job.areas.isEmpty() && !job.areas[0].gate.isEmpty() ? 2 : 1;
+    int bandWidth = (width - 1 - start) / bandCount;
+    QVector<int> bandStart;
+    for(int i = 0; i < bandCount; i++)
+        bandStart.append(start + i * bandWidth);
+    bandStart.append(width - 1);
+
+    for(int i = 0; i < job.areas.size(); i++)
+    {
+        if(job.areas[i].gate.isEmpty())
+            continue;
+
+        for(int y = 1; y < height - 1; y++)
+            wall(bandStart[i], y) = y != corridor;
+        result.gateTiles.insert(job.areas[i].gate, QPoint(bandStart[i], corridor));
+    }
+
+    // Scatter obstacles off the corridor
+    std::bernoulli_distribution obstacle(WORLD_OBSTACLE_DENSITY);
+    for(int y = 1; y < height - 1; y++)
+    {
+        for(int x = 1; x < width - 1; x++)
+        {
+            if(y != corridor && obstacle(random))
+                wall(x, y) = true;
+        }
+    }
+
+    // Keys only go on tiles that can be reached from the corridor
+    QVector<bool> reachable(width * height, false);
+    QQueue<QPoint> open;
+    for(int x = 1; x < width - 1; x++)
+    {
+        if(!wall(x, corridor))
+        {
+            reachable[corridor * width + x] = true;
+            open.enqueue(QPoint(x, corridor));
+        }
+    }
+    while(!open.isEmpty())
+    {
+        QPoint point = open.dequeue();
+        const QPoint steps[] = { QPoint(1, 0), QPoint(-1, 0), QPoint(0, 1), QPoint(0, -1) };
+        for(const QPoint& step : steps)
+        {
+            QPoint next = point + step;
+            if(next.x() < 0 || next.y() < 0 || next.x() >= width || next.y() >= height)
+                continue;
+            int index = next.y() * width + next.x();
+            if(!walls[index] && !reachable[index])
+            {
+                reachable[index] = true;
+                open.enqueue(next);
+            }
+        }
+    }
+
+    // Prefer tiles off the corridor, so keys do not sit in the way
+    QVector<QVector<QPoint>> candidates(job.areas.size());
+    QVector<int> taken(job.areas.size(), 0); // Candidates of each band already holding a key
+    for(int i = 0; i < job.areas.size(); i++)
+    {
+        QVector<QPoint> fallback;
+        for(int x = bandStart[i] + 1; x < bandStart[i + 1]; x++)
+        {
+            for(int y = 1; y < height - 1; y++)
+            {
+                if(reachable[y * width + x])
+                    (y == corridor ? fallback : candidates[i]).append(QPoint(x, y));
+            }
+        }
+        std::shuffle(candidates[i].begin(), candidates[i].end(), random);
+        candidates[i] += fallback;
+    }
+
+    // Keys that do not fit in their own band go in an earlier one, which is still reached before the next gate
+    for(int i = 0; i < job.areas.size(); i++)
+    {
+        for(const QString& key : job.areas[i].keys)
+        {
+            int band = i;
+            while(band >= 0 && taken[band] >= candidates[band].size())
+                band--;
+
+            if(band >= 0)
+                result.keyTiles.insert(key, candidates[band][taken[band]++]);
+            else
+                result.unplacedKeys.append(key);
+        }
+    }
+
+    result.map = Map(job.name, width, height, settings.tileSize, settings.music, settings.world);
+    for(int y = 0; y < height; y++)
+    {
+        for(int x = 0; x < width; x++)
+        {
+            int pattern = wall(x, y) ? settings.wallPattern : settings.floorPattern;
+            result.map.setTile(x, y, MapTile(0, x, y, settings.tileSize, pattern));
+        }
+    }
+
+    return result;
+}
+
+/*!
+ * \brief Builds a destination entity on the given tile. The hero's origin is 8 pixels right and 13 pixels down of the
+ *        top left corner of its 16x16 box.
+ */
+Object buildDestination(QString name, QPoint tile, int tileSize, int direction)
+{
+    Object object;
+    object.insert(ELE_NAME, name);
+    object.insert(ELE_LAYER, "0");
+    object.insert(ELE_X, QString::number(tile.x() * tileSize + 8));
+    object.insert(ELE_Y, QString::number(tile.y() * tileSize + 13));
+    object.insert(ELE_DIRECTION, QString::number(direction));
+    return object;
+}
+
+Object buildTeletransporter(QPoint tile, int tileSize, QString destinationMap, QString destination)
+{
+    Object object;
+    object.insert(ELE_LAYER, "0");
+    object.insert(ELE_X, QString::number(tile.x() * tileSize));
+    object.insert(ELE_Y, QString::number(tile.y() * tileSize));
+    object.insert(ELE_WIDTH, QString::number(tileSize));
+    object.insert(ELE_HEIGHT, QString::number(tileSize));
+    object.insert(ELE_TRANSITION, TRANSITION_FADE);
+    object.insert(ELE_DESTINATION_MAP, destinationMap);
+    object.insert(ELE_DESTINATION, destination);
+    return object;
+}
+
+/*!
+ * \brief Turns a mission item name into a savegame variable name, which may only hold letters, digits and underscores.
+ */
+QString toVariable(QString name)
+{
+    QString variable = name.toLower();
+    for(QChar& c : variable)
+    {
+        if(!c.isLetterOrNumber() || c.unicode() > 127)
+            c = '_';
+    }
+    return "mission_" + variable;
+}
+
+/*!
+ * \brief Builds the common elements of an entity on the given tile. Entities drawn around their origin (chests and
+ *        NPCs) are placed like destinations, others from the tile's top left corner.
+ */
+Object buildEntity(QString name, QPoint tile, int tileSize, bool centered)
+{
+    Object object;
+    object.insert(ELE_NAME, name);
+    object.insert(ELE_LAYER, "0");
+    object.insert(ELE_X, QString::number(tile.x() * tileSize + (centered ? ENTITY_DEFAULT_ORIGIN.x() : 0)));
+    object.insert(ELE_Y, QString::number(tile.y() * tileSize + (centered ? ENTITY_DEFAULT_ORIGIN.y() : 0)));
+    return object;
+}
+
+} // namespace
+
+QList<MissionArea> WorldGenerator::splitMission(MissionItemCollection* items)
+{
+    QList<Gate*> gates = items->getGateList();
+
+    QList<MissionArea> areas;
+    areas.append(MissionArea()); // Start area
+
+    QHash<QString,int> firstArea; // Area opened by the first gate needing each key
+    for(int i = 0; i < gates.size(); i++)
+    {
+        MissionArea area;
+        area.gate = gates[i]->getName();
+        areas.append(area);
+
+        for(const QString& key : gates[i]->getKeys())
+        {
+            if(!firstArea.contains(key))
+                firstArea.insert(key, i + 1);
+        }
+    }
+
+    for(Key* key : items->getKeyEventList())
+        areas[firstArea.value(key->getName(), 1) - 1].keys.append(key->getName());
+
+    return areas;
+}
+
+QList<WorldMap> WorldGenerator::plan(const QList<MissionArea>& areas, const WorldSettings& settings)
+{
+    int maxAreas = qMax(1, (settings.width - 2) / MIN_AREA_WIDTH);
+    int mapCount = qMax(qMax(1, settings.mapCount), (areas.size() + maxAreas - 1) / maxAreas);
+
+    QList<WorldMap> plans;
+    for(int i = 0; i < mapCount; i++)
+    {
+        WorldMap plan;
+        plan.name = settings.prefix + "_" + QString::number(i + 1);
+        plan.index = i;
+        plan.settings = settings;
+
+        int first = i * areas.size() / mapCount;
+        int last = (i + 1) * areas.size() / mapCount;
+        plan.areas = areas.mid(first, last - first);
+
+        // Marks which ends of the corridor lead somewhere, generation puts teletransporters there
+        if(i > 0)
+            plan.entrance = QPoint(0, settings.height / 2);
+        if(i < mapCount - 1)
+            plan.exit = QPoint(settings.width - 1, settings.height / 2);
+
+        plans.append(plan);
+    }
+
+    return plans;
+}
+
+QList<WorldMap> WorldGenerator::generate(const QList<WorldMap>& plans)
+{
+    PROFILE_SCOPE("WorldGenerator::generate");
+
+    return QtConcurrent::blockingMapped<QList<WorldMap>>(plans, generateMap);
+}
+
+QList<MapEntity> WorldGenerator::buildLinks(const WorldMap& map, QString previous, QString next)
+{
+    int tileSize = map.settings.tileSize;
+    QList<MapEntity> entities;
+
+    // The first map's arrival point doubles as the start of the world
+    QPoint arrival(1, map.settings.height / 2);
+    entities.append(MapEntity(OBJ_DESTINATION, buildDestination(DESTINATION_FROM_PREVIOUS, arrival, tileSize, 0)));
+    if(!previous.isEmpty() && map.entrance.x() >= 0)
+        entities.append(MapEntity(OBJ_TELETRANSPORTER, buildTeletransporter(map.entrance, tileSize, previous, DESTINATION_FROM_NEXT)));
+
+    if(!next.isEmpty() && map.exit.x() >= 0)
+    {
+        QPoint departure(map.settings.width - 2, map.settings.height / 2);
+        entities.append(MapEntity(OBJ_DESTINATION, buildDestination(DESTINATION_FROM_NEXT, departure, tileSize, 2)));
+        entities.append(MapEntity(OBJ_TELETRANSPORTER, buildTeletransporter(map.exit, tileSize, next, DESTINATION_FROM_PREVIOUS)));
+    }
+
+    return entities;
+}
+
+QList<MapEntity> WorldGenerator::buildMission(const WorldMap& map, MissionItemCollection* items)
+{
+    int tileSize = map.settings.tileSize;
+    QList<MapEntity> entities;
+
+    // Areas are walked in order rather than the tile hashes, so the same world always builds the same tables
+    for(const MissionArea& area : map.areas)
+    {
+        Gate* gate = items->getGate(area.gate);
+        if(gate != nullptr && map.gateTiles.contains(area.gate))
+        {
+            // Gates face west, towards players coming along the corridor
+            QPoint tile = map.gateTiles.value(area.gate);
+            if(gate->getType() == Gate::NPC)
+            {
+                Object object = buildEntity(gate->getName(), tile, tileSize, true);
+                object.insert(ELE_DIRECTION, "2");
+                object.insert(ELE_SUBTYPE, "0");
+                entities.append(MapEntity(OBJ_NPC, object));
+            }
+            else
+            {
+                Object object = buildEntity(gate->getName(), tile, tileSize, false);
+                object.insert(ELE_DIRECTION, "2");
+                object.insert(ELE_SPRITE, "entities/door");
+                object.insert(ELE_SAVEGAME_VARIABLE, toVariable(gate->getName()));
+                object.insert(ELE_OPENING_METHOD, "by_script");
+                entities.append(MapEntity(OBJ_DOOR, object));
+            }
+        }
+
+        for(const QString& name : area.keys)
+        {
+            Key* key = items->getKeyEvent(name);
+            if(key == nullptr || !map.keyTiles.contains(name))
+                continue;
+
+            QPoint tile = map.keyTiles.value(name);
+            switch(key->getKeyType())
+            {
+            case Key::Switch:
+            {
+                Object object = buildEntity(key->getName(), tile, tileSize, false);
+                object.insert(ELE_SUBTYPE, "walkable");
+                object.insert(ELE_SPRITE, "entities/switch");
+                object.insert(ELE_NEEDS_BLOCK, "false");
+                object.insert(ELE_INACTIVATE_WHEN_LEAVING, "false");
+                entities.append(MapEntity(OBJ_SWITCH, object));
+                break;
+            }
+            case Key::NPC:
+            {
+                Object object = buildEntity(key->getName(), tile, tileSize, true);
+                object.insert(ELE_DIRECTION, "3");
+                object.insert(ELE_SUBTYPE, "0");
+                entities.append(MapEntity(OBJ_NPC, object));
+                break;
+            }
+            default:
+            {
+                // Items are handed out from chests too, the mission does not say which treasure they are
+                Object object = buildEntity(key->getName(), tile, tileSize, true);
+                object.insert(ELE_SPRITE, "entities/chest");
+                object.insert(ELE_TREASURE_SAVEGAME_VARIABLE, toVariable(key->getName()));
+                entities.append(MapEntity(OBJ_CHEST, object));
+                break;
+            }
+            }
+        }
+    }
+
+    return entities;
+}
+
+void WorldGenerator::measure(WorldMap& map)
+{
+    // Same points buildLinks places the arrival and departure destinations on
+    QVector<QPoint> route;
+    route.append(QPoint(1, map.settings.height / 2));
+    for(const MissionArea& area : map.areas)
+    {
+        if(map.gateTiles.contains(area.gate))
+            route.append(map.gateTiles.value(area.gate));
+        for(const QString& key : area.keys)
+        {
+            if(map.keyTiles.contains(key))
+                route.append(map.keyTiles.value(key));
+        }
+    }
+    if(map.exit.x() >= 0)
+        route.append(QPoint(map.settings.width - 2, map.settings.height / 2));
+
+    QVector<qreal> distances = Pathfinder::findDistances(&map.map, route);
+    const int count = route.size();
+
+    map.routeLength = 0.0;
+    for(int i = 0; i + 1 < count && map.routeLength >= 0.0; i++)
+    {
+        qreal leg = distances[i * count + i + 1];
+        map.routeLength = leg < 0.0 ? -1.0 : map.routeLength + leg;
+    }
+
+    qreal direct = distances[count - 1];
+    map.backtracking = map.routeLength < 0.0 || direct < 0.0 ? -1.0 : map.routeLength - direct;
+}
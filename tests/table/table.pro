@@ -0,0 +1,11 @@
+include(../tests.pri)
+
+QT       += testlib
+
+TARGET = tst_table
+CONFIG += testcase
+
+# The fuzz target's entry point also runs over the generated tables, so its checks are exercised without libFuzzer
+SOURCES += \
+    tst_table.cpp \
+    ../tablefuzz/tablefuzz.cpp
@@ -0,0 +1,198 @@
+#include <QtTest>
+#include <random>
+#include <cstdint>
+
+#include "filetools.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+const uint TEST_SEED = 20141027;         /*!< Seed of the generated tables, failures reproduce from run to run. */
+const int PROPERTY_RUNS = 500;           /*!< Number of random tables checked by each property test. */
+const int THROUGHPUT_OBJECTS = 50000;    /*!< Size of the table used to measure parse and write rates. */
+
+/*!
+ * \brief Generates random tables. Names are identifiers, as the format requires, values may hold any character and
+ *        favour the ones the format has to escape or quote.
+ */
+class TableGenerator
+{
+public:
+    TableGenerator(uint seed) : random(seed) { }
+
+    QString name()
+    {
+        static const QString first = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+        static const QString rest = first + "0123456789";
+
+        QString name(1, first[below(first.size())]);
+        for(int i = below(8); i > 0; i--)
+            name.append(rest[below(rest.size())]);
+        return name;
+    }
+
+    QString value()
+    {
+        static const QString special = QString(",\"}{=\\'\n\r\t -") + QChar(0xe9) + QChar(0x6f22);
+        static const QString plain = "abcxyz0189";
+
+        QString value;
+        for(int i = below(12); i > 0; i--)
+        {
+            const QString& from = below(2) ? special : plain;
+            value.append(from[below(from.size())]);
+        }
+        return value;
+    }
+
+    /*!
+     * \brief Fills a table with objects, some of which share a name.
+     */
+    void fill(Table& table, int objects)
+    {
+        QStringList names;
+        for(int i = below(4) + 1; i > 0; i--)
+            names.append(name());
+
+        for(int i = 0; i < objects; i++)
+        {
+            Object object;
+            for(int e = below(6); e > 0; e--)
+                object.insert(name(), value());
+            table.addObject(names[below(names.size())], object);
+        }
+    }
+
+    int below(int bound)
+    {
+        return std::uniform_int_distribution<int>(0, bound - 1)(random);
+    }
+
+private:
+    std::mt19937 random;
+};
+
+class TestTable : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void parseData_data();
+    void parseData();
+    void fuzzEntry();
+    void throughput();
+};
+
+/*!
+ * \brief Any table written out reads back as the same objects, and writing it again gives the same bytes.
+ */
+void TestTable::roundTrip()
+{
+    TableGenerator generator(TEST_SEED);
+    for(int run = 0; run < PROPERTY_RUNS; run++)
+    {
+        Table table;
+        generator.fill(table, generator.below(20));
+        QByteArray bytes = table.toData();
+
+        Table parsed;
+        parsed.parseData(bytes);
+        if(!parsed.areEqual(&table))
+            QFAIL(qPrintable(QString("Run %1 lost data:\n%2").arg(run).arg(QString::fromUtf8(bytes))));
+
+        // Unchanged objects are copied from the source, rewriting them checks the writer is stable too
+        QCOMPARE(parsed.toData(), bytes);
+        for(Object* object : parsed.getObjects())
+            parsed.markDirty(object);
+        QCOMPARE(parsed.toData(), bytes);
+    }
+}
+
+void TestTable::parseData_data()
+{
+    QTest::addColumn<QByteArray>("bytes");
+    QTest::addColumn<int>("objects");
+    QTest::addColumn<QString>("value");
+
+    QTest::newRow("quoted") << QByteArray("map{x = \"a, b}\"}\n") << 1 << QString("a, b}");
+    QTest::newRow("escapes") << QByteArray("map{x = \"\\\"\\\\\\n\"}\n") << 1 << QString("\"\\\n");
+    QTest::newRow("single quotes") << QByteArray("map{x = 'say \"hi\"'}\n") << 1 << QString("say \"hi\"");
+    QTest::newRow("bare") << QByteArray("map{x = 12 , y = 3}\n") << 1 << QString("12");
+    QTest::newRow("comments") << QByteArray("-- map{x = \"1\"}\nmap{x = \"2\"} -- }\n") << 1 << QString("2");
+    QTest::newRow("cut off") << QByteArray("map{x = \"1\"}\nmap{x = \"2\"") << 1 << QString("1");
+}
+
+/*!
+ * \brief Hand written files parse to the expected values, and unchanged tables are written back byte for byte.
+ */
+void TestTable::parseData()
+{
+    QFETCH(QByteArray, bytes);
+    QFETCH(int, objects);
+    QFETCH(QString, value);
+
+    Table table;
+    table.parseData(bytes);
+    QCOMPARE(table.getObjects().size(), objects);
+    QCOMPARE(table.getElementValue("map", "x"), value);
+    QCOMPARE(table.toData(), bytes);
+}
+
+/*!
+ * \brief Runs the fuzz target's checks over generated files and random mutations of them, which is where a fuzzer
+ *        would start from. Failures abort.
+ */
+void TestTable::fuzzEntry()
+{
+    TableGenerator generator(TEST_SEED + 1);
+    for(int run = 0; run < PROPERTY_RUNS; run++)
+    {
+        Table table;
+        generator.fill(table, generator.below(10));
+        QByteArray bytes = table.toData();
+
+        for(int i = generator.below(4); i > 0 && !bytes.isEmpty(); i--)
+        {
+            int at = generator.below(bytes.size());
+            switch(generator.below(3))
+            {
+            case 0:     bytes[at] = static_cast<char>(generator.below(256)); break;
+            case 1:     bytes.remove(at, 1); break;
+            default:    bytes.insert(at, "{}=,\"\\-\n"[generator.below(8)]); break;
+            }
+        }
+
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(bytes.constData()), bytes.size());
+    }
+}
+
+/*!
+ * \brief Reports the rate tables are parsed and written at. Writing rewrites every object, as saving a new table would.
+ */
+void TestTable::throughput()
+{
+    Table table;
+    TableGenerator(TEST_SEED).fill(table, THROUGHPUT_OBJECTS);
+    QByteArray bytes = table.toData();
+    qreal megabytes = bytes.size() / (1024.0 * 1024.0);
+
+    QElapsedTimer timer;
+    timer.start();
+    Table parsed;
+    parsed.parseData(bytes);
+    qint64 parseTime = timer.nsecsElapsed();
+
+    for(Object* object : parsed.getObjects())
+        parsed.markDirty(object);
+    timer.restart();
+    QByteArray written = parsed.toData();
+    qint64 writeTime = timer.nsecsElapsed();
+
+    QCOMPARE(written, bytes);
+    qDebug("%.2f MB: parse %.1f MB/s, write %.1f MB/s", megabytes,
+           megabytes / qMax(parseTime, qint64(1)) * 1e9, megabytes / qMax(writeTime, qint64(1)) * 1e9);
+}
+
+QTEST_APPLESS_MAIN(TestTable)
+
+#include "tst_table.moc"
@@ -0,0 +1,35 @@
+#include "filetools.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+/*!
+ * \brief Fuzz entry point for Table::parseData. Any input must parse without crashing, and the parsed table must hold:
+ *        - unchanged, it is written back byte for byte;
+ *        - with every object rewritten, it reads back as the same objects, and writing that again gives the same bytes.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    QByteArray bytes(reinterpret_cast<const char*>(data), static_cast<int>(size));
+
+    Table table;
+    table.parseData(bytes);
+    if(table.toData() != bytes)
+        abort();
+
+    for(Object* object : table.getObjects())
+        table.markDirty(object);
+    QByteArray written = table.toData();
+
+    Table parsed;
+    parsed.parseData(written);
+    if(!parsed.areEqual(&table))
+        abort();
+
+    for(Object* object : parsed.getObjects())
+        parsed.markDirty(object);
+    if(parsed.toData() != written)
+        abort();
+
+    return 0;
+}
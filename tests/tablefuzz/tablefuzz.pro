@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tablefuzz
+
+# libFuzzer provides main, run with: ./tablefuzz corpus_dir
+QMAKE_CXXFLAGS += -fsanitize=fuzzer,address,undefined
+QMAKE_LFLAGS += -fsanitize=fuzzer,address,undefined
+
+SOURCES += \
+    tablefuzz.cpp
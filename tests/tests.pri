@@ -0,0 +1,19 @@
+# Settings shared by every test project, which compile the sources they test directly
+
+QT       += core
+QT       -= gui
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+QMAKE_CXXFLAGS += -std=c++11
+
+INCLUDEPATH += $$PWD/../include
+
+SOURCES += \
+    $$PWD/../src/filetools.cpp \
+    $$PWD/../src/profiler.cpp
+
+HEADERS += \
+    $$PWD/../include/filetools.h \
+    $$PWD/../include/profiler.h
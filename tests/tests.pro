@@ -0,0 +1,16 @@
+#-------------------------------------------------
+#
+# Tests for the data file tools. Build and run with:
+#   qmake tests/tests.pro && make && make check
+#
+# Build with CONFIG+=fuzz (and a clang spec, e.g. -spec linux-clang) to also build a libFuzzer target for Table::parseData
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS += table
+
+fuzz {
+    SUBDIRS += tablefuzz
+}